@@ -5,6 +5,7 @@
 #ifndef LUWU_ADDRESS_H
 #define LUWU_ADDRESS_H
 
+#include <string>
 #include <memory>
 #include <sys/socket.h>
 #include <arpa/inet.h>
@@ -5,6 +5,7 @@
 #ifndef LUWU_BYTE_ARRAY_H
 #define LUWU_BYTE_ARRAY_H
 
+#include <string>
 #include <memory>
 #include <vector>
 #include <cstring>
@@ -0,0 +1,123 @@
+//
+// Created by liucxi on 2022/12/10.
+//
+
+#include "cancel_token.h"
+
+#include "fiber.h"
+#include "fiber_local.h"
+#include "utils/util.h"
+
+namespace luwu {
+
+    // 当前协程绑定的令牌，随协程结束或 reset 一起释放
+    static FiberLocal<CancelToken::ptr> s_current_token;
+
+    CancelToken::Guard::Guard(const CancelToken::ptr &token)
+        : prev_(CancelToken::GetCurrent()) {
+        CancelToken::SetCurrent(token);
+    }
+
+    CancelToken::Guard::~Guard() {
+        CancelToken::SetCurrent(prev_);
+    }
+
+    CancelToken::CancelToken(uint64_t deadline)
+        : error_(0), deadline_(deadline), next_id_(0), parent_callback_id_(0) {
+    }
+
+    CancelToken::ptr CancelToken::Create(uint64_t timeout, const ptr &parent) {
+        uint64_t deadline = timeout ? getCurrentTime() + timeout : 0;
+        if (parent && parent->deadline_ && (!deadline || parent->deadline_ < deadline)) {
+            deadline = parent->deadline_;
+        }
+        ptr token(new CancelToken(deadline));
+
+        if (parent) {
+            std::weak_ptr<CancelToken> weak_token(token);
+            uint64_t id;
+            if (parent->addCallback([weak_token](int error) {
+                auto t = weak_token.lock();
+                if (t) {
+                    t->cancel(error);
+                }
+            }, id)) {
+                token->parent_ = parent;
+                token->parent_callback_id_ = id;
+            } else {
+                token->cancel(parent->getError());
+            }
+        }
+        return token;
+    }
+
+    CancelToken::~CancelToken() {
+        if (parent_) {
+            parent_->delCallback(parent_callback_id_);
+        }
+    }
+
+    void CancelToken::cancel(int error) {
+        std::map<uint64_t, cancel_callback> callbacks;
+        {
+            Mutex::Lock lock(mutex_);
+            if (error_) {
+                return;
+            }
+            error_ = error;
+            callbacks.swap(callbacks_);
+        }
+        for (auto &item : callbacks) {
+            item.second(error);
+        }
+    }
+
+    int CancelToken::getError() {
+        {
+            Mutex::Lock lock(mutex_);
+            if (error_) {
+                return error_;
+            }
+        }
+        return deadline_ && getCurrentTime() >= deadline_ ? ETIMEDOUT : 0;
+    }
+
+    uint64_t CancelToken::getRemaining() const {
+        if (!deadline_) {
+            return UINT64_MAX;
+        }
+        uint64_t now = getCurrentTime();
+        return now >= deadline_ ? 0 : deadline_ - now;
+    }
+
+    bool CancelToken::addCallback(cancel_callback callback, uint64_t &id) {
+        Mutex::Lock lock(mutex_);
+        if (error_) {
+            return false;
+        }
+        id = ++next_id_;
+        callbacks_.emplace(id, std::move(callback));
+        return true;
+    }
+
+    void CancelToken::delCallback(uint64_t id) {
+        Mutex::Lock lock(mutex_);
+        callbacks_.erase(id);
+    }
+
+    void CancelToken::SetCurrent(const ptr &token) {
+        if (token) {
+            s_current_token.set(token);
+        } else if (s_current_token.has()) {
+            s_current_token.reset();
+        }
+    }
+
+    CancelToken::ptr CancelToken::GetCurrent() {
+        // 没有运行中的协程（比如线程刚启动）时不可能绑定过令牌
+        if (Fiber::GetFiberId() == static_cast<uint32_t>(-1) || !s_current_token.has()) {
+            return nullptr;
+        }
+        return *s_current_token;
+    }
+}
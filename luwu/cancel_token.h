@@ -0,0 +1,132 @@
+//
+// Created by liucxi on 2022/12/10.
+//
+
+#ifndef LUWU_CANCEL_TOKEN_H
+#define LUWU_CANCEL_TOKEN_H
+
+#include <map>
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+#include <functional>
+#include "utils/mutex.h"
+#include "utils/noncopyable.h"
+
+namespace luwu {
+    /**
+     * @brief 协程取消令牌，包含一个可选的截止时间
+     * @details 通过 SetCurrent 绑定到当前协程之后，被 hook 的 read/write/connect/accept 等 IO 函数会把截止时间
+     * 与 socket 的超时时间取较小值，超过截止时间返回 ETIMEDOUT；令牌被 cancel 时，阻塞在 IO 上的协程立即被唤醒并返回 ECANCELED。
+     * 同一个令牌可以交给多个子任务共享，子令牌会在父令牌被取消时一起被取消
+     */
+    class CancelToken : NonCopyable, public std::enable_shared_from_this<CancelToken> {
+    public:
+        using ptr = std::shared_ptr<CancelToken>;
+
+        /**
+         * @brief 取消回调，参数为取消的原因（错误码）
+         */
+        using cancel_callback = std::function<void(int error)>;
+
+        /**
+         * @brief 在作用域内把令牌绑定到当前协程，离开作用域时恢复原来的令牌
+         */
+        class Guard : NonCopyable {
+        public:
+            explicit Guard(const CancelToken::ptr &token);
+
+            ~Guard();
+
+        private:
+            /// 原来绑定的令牌
+            CancelToken::ptr prev_;
+        };
+
+        /**
+         * @brief 创建令牌
+         * @param timeout 从现在开始的超时时间，单位毫秒，0 表示没有截止时间
+         * @param parent 父令牌，截止时间不会晚于父令牌，父令牌取消时本令牌一起取消
+         * @return 令牌
+         */
+        static ptr Create(uint64_t timeout = 0, const ptr &parent = nullptr);
+
+        /**
+         * @brief 析构函数，从父令牌上注销
+         */
+        ~CancelToken();
+
+        /**
+         * @brief 取消令牌，执行所有已注册的回调，只有第一次调用有效
+         * @param error 取消的原因，默认为 ECANCELED
+         */
+        void cancel(int error = ECANCELED);
+
+        /**
+         * @brief 获取令牌的状态
+         * @return 0 表示仍然有效，否则为取消的原因，超过截止时间为 ETIMEDOUT
+         */
+        int getError();
+
+        bool isCancelled() {
+            return getError() != 0;
+        }
+
+        /**
+         * @brief 获取距离截止时间的剩余时间
+         * @return 剩余毫秒数，已经过期时为 0，没有截止时间时为 UINT64_MAX
+         */
+        uint64_t getRemaining() const;
+
+        /**
+         * @brief 注册取消回调，回调在调用 cancel 的线程上执行，只用于唤醒等待者，不能阻塞
+         * @param callback 回调函数
+         * @param id 回调的编号，用于注销
+         * @return 是否注册成功，已经被取消时返回 false
+         */
+        bool addCallback(cancel_callback callback, uint64_t &id);
+
+        /**
+         * @brief 注销取消回调
+         * @param id addCallback 返回的编号
+         */
+        void delCallback(uint64_t id);
+
+        uint64_t getDeadline() const { return deadline_; }
+
+        /**
+         * @brief 把令牌绑定到当前协程，协程结束时自动解除
+         * @param token 令牌，nullptr 表示解除绑定
+         */
+        static void SetCurrent(const ptr &token);
+
+        /**
+         * @brief 获取当前协程绑定的令牌
+         * @return 令牌，没有绑定时为 nullptr
+         */
+        static ptr GetCurrent();
+
+    private:
+        /**
+         * @brief 私有构造函数，通过 Create 创建
+         * @param deadline 绝对截止时间，0 表示没有截止时间
+         */
+        explicit CancelToken(uint64_t deadline);
+
+    private:
+        Mutex mutex_;
+        /// 取消的原因，0 表示没有被显式取消
+        int error_;
+        /// 截止时间，与 getCurrentTime() 同一时间基准，0 表示没有截止时间
+        uint64_t deadline_;
+        /// 下一个回调的编号
+        uint64_t next_id_;
+        /// 已注册的回调
+        std::map<uint64_t, cancel_callback> callbacks_;
+        /// 父令牌，以及注册在父令牌上的回调编号
+        ptr parent_;
+        uint64_t parent_callback_id_;
+    };
+}
+
+#endif //LUWU_CANCEL_TOKEN_H
@@ -28,18 +28,31 @@ namespace luwu {
 
     bool Clock::cancel() {
         RWMutex::WriteLock lock(manager_->mutex_);
-        if (clock_callback_) {
+        if (isActive()) {
+            cancelled_ = true;
+            // 周期定时器的回调正在执行，不在 clocks_ 中，执行结束之后再释放回调
+            if (running_) {
+                return true;
+            }
             clock_callback_ = nullptr;
+            // 已经触发过的一次性定时器不在 clocks_ 中了
             auto it = manager_->clocks_.find(shared_from_this());
-            manager_->clocks_.erase(it);
-            return true;
+            if (it != manager_->clocks_.end()) {
+                manager_->clocks_.erase(it);
+                return true;
+            }
         }
         return false;
     }
 
     bool Clock::refresh() {
         RWMutex::WriteLock lock(manager_->mutex_);
-        if (clock_callback_) {
+        if (isActive()) {
+            // 回调正在执行，执行结束之后按新的时间放回
+            if (running_) {
+                time_ = getCurrentTime() + period_;
+                return true;
+            }
             auto it = manager_->clocks_.find(shared_from_this());
             if (it == manager_->clocks_.end()) {
                 return false;
@@ -55,7 +68,12 @@ namespace luwu {
 
     bool Clock::reset(uint64_t period, bool from_now) {
         RWMutex::WriteLock lock(manager_->mutex_);
-        if (clock_callback_) {
+        if (isActive()) {
+            if (running_) {
+                period_ = period;
+                time_ = from_now ? getCurrentTime() + period_ : time_;
+                return true;
+            }
             auto it = manager_->clocks_.find(shared_from_this());
             if (it == manager_->clocks_.end()) {
                 return false;
@@ -73,32 +91,35 @@ namespace luwu {
 
     // region # Clock::Clock()
     Clock::Clock(uint64_t time)
-        : recurring_(false), period_(0), time_(time), clock_callback_(nullptr), manager_(nullptr) {
+        : recurring_(false), period_(0), time_(time), clock_callback_(nullptr), running_(false), cancelled_(false)
+        , manager_(nullptr) {
     }
 
-    Clock::Clock(bool recurring, uint64_t period, std::function<void()> callback, ClockManager *manager)
+    Clock::Clock(bool recurring, uint64_t period, clock_callback callback, ClockManager *manager)
         : recurring_(recurring), period_(period), time_(getCurrentTime() + period_)
-        , clock_callback_(std::move(callback)), manager_(manager) {
+        , clock_callback_(std::move(callback)), running_(false), cancelled_(false), manager_(manager) {
     }
     // endregion
 
-    Clock::ptr ClockManager::addClock(uint64_t period, std::function<void()> callback, bool recurring) {
+    void Clock::runRecurring() {
+        // 执行期间定时器不在管理器中，只有 cancel 会访问它，而 cancel 不会释放正在执行的回调，这里不需要加锁
+        clock_callback_();
+        RWMutex::WriteLock lock(manager_->mutex_);
+        running_ = false;
+        if (cancelled_) {
+            clock_callback_ = nullptr;
+            return;
+        }
+        manager_->addClock(shared_from_this(), lock);
+    }
+
+    Clock::ptr ClockManager::addClock(uint64_t period, Clock::clock_callback callback, bool recurring) {
         Clock::ptr clock1(new Clock(recurring, period, std::move(callback), this));
         RWMutex::WriteLock lock(mutex_);
         addClock(clock1, lock);
         return clock1;
     }
 
-    Clock::ptr ClockManager::addCondClock(uint64_t period, const std::function<void()>& callback,
-                                          const std::weak_ptr<void> &weak_cond, bool recurring) {
-        return addClock(period, [weak_cond, callback]() {
-            std::shared_ptr<void> tmp = weak_cond.lock();
-            if (tmp) {
-                callback();
-            }
-        }, recurring);
-    }
-
     uint64_t ClockManager::getNextTime() {
         RWMutex::ReadLock lock(mutex_);
         tickled_ = false;
@@ -115,7 +136,7 @@ namespace luwu {
         }
     }
 
-    void ClockManager::listExpiredCallback(std::vector<std::function<void()>> &callbacks) {
+    void ClockManager::listExpiredCallback(std::vector<Clock::clock_callback> &callbacks) {
         {
             RWMutex::ReadLock lock(mutex_);
             if (clocks_.empty()) {
@@ -131,11 +152,16 @@ namespace luwu {
         expired.insert(expired.begin(), clocks_.begin(), it);
 
         for (auto &clock : expired) {
-            callbacks.push_back(clock->clock_callback_);
             clocks_.erase(clock);
-            if (clock->recurring_) {
-                clock->time_ = now + clock->time_;
-                clocks_.insert(clock);
+            if (!clock->recurring_) {
+                callbacks.push_back(std::move(clock->clock_callback_));
+            } else {
+                // 回调执行结束之后再放回 clocks_，同一个定时器的回调不会同时执行
+                clock->running_ = true;
+                clock->time_ = now + clock->period_;
+                callbacks.emplace_back([clock]() {
+                    clock->runRecurring();
+                });
             }
         }
     }
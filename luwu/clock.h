@@ -8,8 +8,8 @@
 #include <set>
 #include <memory>
 #include <vector>
-#include <functional>
 #include "utils/mutex.h"
+#include "utils/inplace_function.h"
 
 namespace luwu {
     class ClockManager;
@@ -24,9 +24,9 @@ namespace luwu {
         using ptr = std::shared_ptr<Clock>;
 
         /**
-         * @brief 定时器回调函数
+         * @brief 定时器回调函数，与调度任务类型相同，到期后直接移入调度器
          */
-        using clock_callback = std::function<void()>;
+        using clock_callback = task_func;
 
         /**
          * @brief 取消定时器
@@ -65,6 +65,18 @@ namespace luwu {
          */
         Clock(bool recurring, uint64_t period, clock_callback callback, ClockManager *manager);
 
+        /**
+         * @brief 定时器是否还有效，没有被取消，一次性定时器也还没有触发
+         */
+        bool isActive() const {
+            return clock_callback_ && !cancelled_;
+        }
+
+        /**
+         * @brief 执行周期定时器的回调，结束之后重新放回管理器
+         */
+        void runRecurring();
+
     private:
         /// 是否重复
         bool recurring_;
@@ -72,8 +84,12 @@ namespace luwu {
         uint64_t period_;
         /// 具体的执行时间
         uint64_t time_;
-        /// 定时器回调函数
+        /// 回调函数，一次性定时器触发时移出，周期定时器一直保留
         clock_callback clock_callback_;
+        /// 周期定时器的回调是否正在执行，执行期间定时器不在管理器中，不会再次触发
+        bool running_;
+        /// 是否已经取消，回调正在执行时由执行结束的一方释放回调
+        bool cancelled_;
         /// 定时器所属的管理器
         ClockManager *manager_;
 
@@ -106,6 +122,8 @@ namespace luwu {
          * @param callback 定时器回调函数
          * @param recurring 是否重复
          * @return 新增的定时器智能指针
+         * @details 周期定时器的回调执行结束之后才重新放回管理器，同一个定时器的回调不会同时执行；
+         * 回调比周期慢时，下一次在它结束之后立即执行
          */
         Clock::ptr addClock(uint64_t period, Clock::clock_callback callback, bool recurring = false);
 
@@ -117,8 +135,11 @@ namespace luwu {
          * @param recurring 是否重复
          * @return 新增的定时器智能指针
          */
-        Clock::ptr addCondClock(uint64_t period, const Clock::clock_callback& callback,
-                                const std::weak_ptr<void> &weak_cond, bool recurring = false);
+        template<typename Callback>
+        Clock::ptr addCondClock(uint64_t period, Callback callback, const std::weak_ptr<void> &weak_cond,
+                                bool recurring = false) {
+            return addClock(period, CondCallback<Callback>(std::move(callback), weak_cond), recurring);
+        }
 
         /**
          * @brief 获得距离最近发生的定时器的时间
@@ -132,6 +153,27 @@ namespace luwu {
          */
         void listExpiredCallback(std::vector<Clock::clock_callback> &callbacks);
 
+    private:
+        /**
+         * @brief 条件定时器的回调，条件还存在时才执行
+         * @details 直接保存原始的函数对象而不是再包一层 clock_callback，常见的回调加上条件仍然可以放在定时器回调内部
+         */
+        template<typename Callback>
+        struct CondCallback {
+            CondCallback(Callback callback, std::weak_ptr<void> weak_cond)
+                : callback_(std::move(callback)), weak_cond_(std::move(weak_cond)) {}
+
+            void operator()() {
+                std::shared_ptr<void> tmp = weak_cond_.lock();
+                if (tmp) {
+                    callback_();
+                }
+            }
+
+            Callback callback_;
+            std::weak_ptr<void> weak_cond_;
+        };
+
     protected:
         /**
          * @brief 当插入一个定时器到堆顶时需要执行的操作
@@ -0,0 +1,163 @@
+//
+// Created by liucxi on 2022/12/2.
+//
+
+#include "context.h"
+
+#include <cstdint>
+#include <cstring>
+#include "utils/asserts.h"
+
+#ifndef LUWU_USE_UCONTEXT
+/**
+ * @brief 保存 callee-saved 寄存器到当前栈上，把栈顶记录在 *from_sp 中，然后切换到 to_sp 所指的栈并恢复寄存器
+ * @details 调用者保存的寄存器已经由编译器在调用点处理，所以这里只需要保存 ABI 规定的被调用者保存寄存器，
+ * 不涉及信号掩码，整个切换不会陷入内核
+ */
+extern "C" __attribute__((visibility("hidden"))) void luwu_switch_context(void **from_sp, void *to_sp);
+
+#if defined(__x86_64__)
+// 栈上的布局（从低地址到高地址）：mxcsr/x87 控制字、r12、r13、r14、r15、rbx、rbp、返回地址
+asm(R"(
+    .text
+    .globl  luwu_switch_context
+    .hidden luwu_switch_context
+    .type   luwu_switch_context, @function
+    .align  16
+luwu_switch_context:
+    pushq   %rbp
+    pushq   %rbx
+    pushq   %r15
+    pushq   %r14
+    pushq   %r13
+    pushq   %r12
+    leaq    -8(%rsp), %rsp
+    stmxcsr (%rsp)
+    fnstcw  4(%rsp)
+    movq    %rsp, (%rdi)
+    movq    %rsi, %rsp
+    ldmxcsr (%rsp)
+    fldcw   4(%rsp)
+    leaq    8(%rsp), %rsp
+    popq    %r12
+    popq    %r13
+    popq    %r14
+    popq    %r15
+    popq    %rbx
+    popq    %rbp
+    ret
+    .size   luwu_switch_context, .-luwu_switch_context
+)");
+#elif defined(__aarch64__)
+// 栈上的布局（从低地址到高地址）：d8-d15、x19-x28、x29(fp)、x30(lr)
+asm(R"(
+    .text
+    .globl  luwu_switch_context
+    .hidden luwu_switch_context
+    .type   luwu_switch_context, %function
+    .align  4
+luwu_switch_context:
+    sub     sp, sp, #0xa0
+    stp     d8,  d9,  [sp, #0x00]
+    stp     d10, d11, [sp, #0x10]
+    stp     d12, d13, [sp, #0x20]
+    stp     d14, d15, [sp, #0x30]
+    stp     x19, x20, [sp, #0x40]
+    stp     x21, x22, [sp, #0x50]
+    stp     x23, x24, [sp, #0x60]
+    stp     x25, x26, [sp, #0x70]
+    stp     x27, x28, [sp, #0x80]
+    stp     x29, x30, [sp, #0x90]
+    mov     x9, sp
+    str     x9, [x0]
+    mov     sp, x1
+    ldp     d8,  d9,  [sp, #0x00]
+    ldp     d10, d11, [sp, #0x10]
+    ldp     d12, d13, [sp, #0x20]
+    ldp     d14, d15, [sp, #0x30]
+    ldp     x19, x20, [sp, #0x40]
+    ldp     x21, x22, [sp, #0x50]
+    ldp     x23, x24, [sp, #0x60]
+    ldp     x25, x26, [sp, #0x70]
+    ldp     x27, x28, [sp, #0x80]
+    ldp     x29, x30, [sp, #0x90]
+    add     sp, sp, #0xa0
+    ret
+    .size   luwu_switch_context, .-luwu_switch_context
+)");
+#endif
+#endif
+
+namespace luwu {
+
+#ifdef LUWU_USE_UCONTEXT
+    void Context::make(void *stack, size_t size, entry_func entry) {
+        if (::getcontext(&context_)) {
+            LUWU_ASSERT2(false, "getcontext");
+        }
+        // 当前上下文结束之后运行的上下文为空，那么在本协程运行结束时必须要调用 setcontext 或 swapcontext 以重新指定一个有效的上下文，
+        // 否则程序就跑飞了，在代码中体现为 Fiber::MainFunc 的最后 yield 一次，在 yield 中恢复了主协程的运行
+        context_.uc_link = nullptr;
+        context_.uc_stack.ss_sp = stack;
+        context_.uc_stack.ss_size = size;
+        makecontext(&context_, entry, 0);
+    }
+
+    void Context::switchTo(Context &to) {
+        // 当前上下文保存在第一个参数里，从第二个参数读出上下文恢复执行
+        if (swapcontext(&context_, &to.context_)) {
+            LUWU_ASSERT2(false, "swapcontext error");
+        }
+    }
+
+    void *Context::getStackPointer() const {
+#if defined(__x86_64__)
+        return reinterpret_cast<void *>(context_.uc_mcontext.gregs[REG_RSP]);
+#elif defined(__aarch64__)
+        return reinterpret_cast<void *>(context_.uc_mcontext.sp);
+#else
+        return nullptr;
+#endif
+    }
+
+    const char *Context::Backend() {
+        return "ucontext";
+    }
+#else
+    void Context::make(void *stack, size_t size, entry_func entry) {
+        // 栈从高地址向低地址增长，栈顶按 16 字节对齐
+        auto top = (reinterpret_cast<uintptr_t>(stack) + size) & ~static_cast<uintptr_t>(15);
+        auto *frame = reinterpret_cast<uint64_t *>(top);
+#if defined(__x86_64__)
+        // 伪造一次 luwu_switch_context 保存下来的现场：ret 弹出 entry 后 rsp % 16 == 8，与正常 call 进入函数时一致，
+        // entry 的返回地址为 0，入口函数不允许返回
+        frame -= 9;
+        memset(frame, 0, 9 * sizeof(uint64_t));
+        frame[0] = 0x037F00001F80ull;       // 低 4 字节 mxcsr，高位是 x87 控制字，都取默认值
+        frame[7] = reinterpret_cast<uint64_t>(entry);
+#elif defined(__aarch64__)
+        // 伪造一次 luwu_switch_context 保存下来的现场：x30(lr) 指向 entry，ret 之后 sp 正好回到栈顶
+        frame -= 20;
+        memset(frame, 0, 20 * sizeof(uint64_t));
+        frame[19] = reinterpret_cast<uint64_t>(entry);
+#endif
+        sp_ = frame;
+    }
+
+    void Context::switchTo(Context &to) {
+        luwu_switch_context(&sp_, to.sp_);
+    }
+
+    void *Context::getStackPointer() const {
+        return sp_;
+    }
+
+    const char *Context::Backend() {
+#if defined(__x86_64__)
+        return "x86_64 asm";
+#else
+        return "aarch64 asm";
+#endif
+    }
+#endif
+}
@@ -0,0 +1,69 @@
+//
+// Created by liucxi on 2022/12/2.
+//
+
+#ifndef LUWU_CONTEXT_H
+#define LUWU_CONTEXT_H
+
+#include <cstddef>
+
+// 非 x86-64 / aarch64 平台没有手写的上下文切换实现，只能退回到 ucontext
+#if !defined(LUWU_USE_UCONTEXT) && !defined(__x86_64__) && !defined(__aarch64__)
+#define LUWU_USE_UCONTEXT
+#endif
+
+#ifdef LUWU_USE_UCONTEXT
+#include <ucontext.h>
+#endif
+
+namespace luwu {
+    /**
+     * @brief 协程上下文，封装具体的上下文切换实现
+     * @details 默认使用手写汇编只保存 callee-saved 寄存器，不像 swapcontext 那样每次切换都调用 rt_sigprocmask；
+     * 编译时定义 LUWU_USE_UCONTEXT（cmake -DUSE_UCONTEXT=ON）则退回到 ucontext 实现
+     */
+    class Context {
+    public:
+        /**
+         * @brief 上下文入口函数，不允许返回
+         */
+        using entry_func = void (*)();
+
+        /**
+         * @brief 在给定的栈空间上构造一个新的上下文，第一次切换到该上下文时从 entry 开始执行
+         * @param stack 栈空间起始地址（低地址）
+         * @param size 栈空间大小
+         * @param entry 入口函数
+         */
+        void make(void *stack, size_t size, entry_func entry);
+
+        /**
+         * @brief 保存当前执行上下文到本对象，并切换到 to 执行
+         * @param to 需要切换到的上下文
+         */
+        void switchTo(Context &to);
+
+        /**
+         * @brief 获取切换出去时保存的栈顶指针，只在本上下文没有运行时有效
+         * @return 栈顶指针，无法获取时返回 nullptr
+         */
+        void *getStackPointer() const;
+
+        /**
+         * @brief 获取当前使用的上下文切换实现的名称
+         * @return 实现名称
+         */
+        static const char *Backend();
+
+    private:
+#ifdef LUWU_USE_UCONTEXT
+        /// ucontext 上下文
+        ucontext_t context_{};
+#else
+        /// 切换出去时保存的栈顶指针，寄存器都保存在栈上
+        void *sp_ = nullptr;
+#endif
+    };
+}
+
+#endif //LUWU_CONTEXT_H
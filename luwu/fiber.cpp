@@ -4,9 +4,12 @@
 
 #include "fiber.h"
 #include <atomic>
+#include <cstring>
 #include <utility>
 #include "scheduler.h"
+#include "stack_allocator.h"
 #include "utils/asserts.h"
+#include "utils/util.h"
 
 namespace luwu {
 
@@ -16,6 +19,8 @@ namespace luwu {
     static std::atomic<uint32_t> s_fiber_id{0};
     // 可增可减，用来记录当前正在运行的线程数量（进程级别）
     static std::atomic<uint32_t> s_fiber_num{0};
+    // 只增不减，已经分配出去的协程局部变量槽位数量
+    static std::atomic<uint32_t> s_local_slot_num{0};
 
     // 线程局部变量，不同线程有不同的对象
 
@@ -31,43 +36,65 @@ namespace luwu {
      * 但是用户在构造 Fiber 对象时可能会使用 Fiber::ptr，所以还会出现裸指针与智能指针混用的问题，无论怎样都没有想到一个完美的解决方案。
      */
     static thread_local Fiber *t_thread_fiber = nullptr;
-    // 默认的协程栈空间大小
-    static const uint32_t stack_size = 128 * 1024;
+
+    // 共享栈大小，共享栈模式下所有协程都运行在这个大小的栈上
+    static const uint32_t s_shared_stack_size = Fiber::STACK_LARGE;
+
+    /**
+     * @brief 线程共享栈，共享栈模式的协程都在这个栈上运行，切换时只把用到的部分拷贝出去
+     */
+    struct SharedStack {
+        /// 栈空间地址
+        void *stack_ = nullptr;
+        /// 当前占用共享栈的协程，该协程的栈内容还没有拷贝出去
+        Fiber *occupant_ = nullptr;
+
+        ~SharedStack() {
+            StackAllocator::Dealloc(stack_, s_shared_stack_size);
+        }
+
+        char *top() {
+            if (!stack_) {
+                stack_ = StackAllocator::Alloc(s_shared_stack_size);
+            }
+            return static_cast<char *>(stack_) + s_shared_stack_size;
+        }
+    };
+
+    static thread_local SharedStack t_shared_stack;
 
     Fiber::Fiber()
-        : id_(s_fiber_id++), state_(RUNNING), stack_size_(0), run_in_scheduler_(false) {
+        : id_(s_fiber_id++), state_(RUNNING), stack_size_(0), run_in_scheduler_(false)
+        , shared_stack_(false), shared_started_(false), bound_tid_(-1), pending_tid_(-1), priority_(1) {
         ++s_fiber_num;
         SetThis(this);      // 创建主协程时线程没有其他协程，当前正在运行的协程，由于 this 指针的缘故，必须在这里设置
-        if (::getcontext(&context_)) {
-            LUWU_ASSERT2(false, "getcontext");
-        }
+        // 主协程的上下文在第一次切换出去时保存，这里不需要初始化
     }
 
-    Fiber::Fiber(fiber_func func, bool run_in_scheduler)
+    Fiber::Fiber(fiber_func func, bool run_in_scheduler, uint32_t stack_size, bool shared_stack)
         : id_(s_fiber_id++), state_(READY), func_(std::move(func))
-        , stack_size_(stack_size), run_in_scheduler_(run_in_scheduler) {
+        , stack_size_(stack_size ? stack_size : STACK_DEFAULT), run_in_scheduler_(run_in_scheduler)
+        , shared_stack_(shared_stack), shared_started_(false), bound_tid_(-1), pending_tid_(-1), priority_(1) {
         ++s_fiber_num;
 
         // 创建协程之前要看一下有没有主协程，如果没有要先创建主协程
         LUWU_ASSERT(t_main_fiber);
 
-        stack_ = ::malloc(stack_size_);
-        if (::getcontext(&context_)) {
-            LUWU_ASSERT2(false, "getcontext");
+        if (shared_stack_) {
+            // 共享栈协程在第一次 resume 时才在共享栈上构造上下文
+            stack_size_ = s_shared_stack_size;
+        } else {
+            stack_ = StackAllocator::Alloc(stack_size_);
+            context_.make(stack_, stack_size_, &Fiber::MainFunc);    // 设置协程入口函数
         }
-        // 当前上下文结束之后运行的上下文为空，那么在本协程运行结束时必须要调用 setcontext 或 swapcontext 以重新指定一个有效的上下文，
-        // 否则程序就跑飞了，在代码中体现为 Fiber::MainFunc 的最后 yield 一次，在 yield 中恢复了主协程的运行
-        context_.uc_link = nullptr;
-        context_.uc_stack.ss_sp = stack_;
-        context_.uc_stack.ss_size = stack_size_;
-        makecontext(&context_, &Fiber::MainFunc, 0);    // 设置协程入口函数
     }
 
     Fiber::~Fiber() {
         --s_fiber_num;
-        if (stack_) {                       // 有栈空间，说明是普通协程
+        clearLocals();
+        if (stack_ || shared_stack_) {      // 有栈空间或者使用共享栈，说明是普通协程
             LUWU_ASSERT(state_ == TERM);
-            ::free(stack_);
+            StackAllocator::Dealloc(stack_, stack_size_);
         } else {                            // 没有栈空间，说明是主协程
             LUWU_ASSERT(state_ == RUNNING);
             LUWU_ASSERT(!func_);
@@ -78,58 +105,153 @@ namespace luwu {
     }
 
     void Fiber::reset(fiber_func func) {
-        LUWU_ASSERT(stack_);
+        LUWU_ASSERT(stack_ || shared_stack_);
         LUWU_ASSERT(state_ == TERM);
 
+        clearLocals();
+        name_.clear();
         state_ = READY;
         func_ = std::move(func);
-
-        if (::getcontext(&context_)) {
-            LUWU_ASSERT2(false, "getcontext");
+        if (shared_stack_) {
+            shared_started_ = false;
+            bound_tid_ = -1;
+            saved_stack_.clear();
+        } else {
+            context_.make(stack_, stack_size_, &Fiber::MainFunc);
         }
-        context_.uc_link = nullptr;
-        context_.uc_stack.ss_size = stack_size_;
-        context_.uc_stack.ss_sp = stack_;
-        makecontext(&context_, &Fiber::MainFunc, 0);
     }
 
     void Fiber::yield() {
-        LUWU_ASSERT(state_ == RUNNING || state_ == TERM);
+        State state = state_.load(std::memory_order_acquire);
+        LUWU_ASSERT(state == RUNNING || state == NOTIFIED || state == TERM);
+        // 直接在调度协程上执行的任务没有自己的协程，yield 会把调度协程本身切换出去
+        LUWU_ASSERT2(!Scheduler::InInlineTask(), "inline task must not yield or block on hooked io");
 
-        if (state_ == RUNNING) {
-            state_ = READY;
+        // 已经被唤醒（NOTIFIED）或者已经结束（TERM）时保持不变
+        if (state == RUNNING) {
+            state_.compare_exchange_strong(state, SUSPENDING, std::memory_order_acq_rel);
         }
         if (run_in_scheduler_) {
             SetThis(Scheduler::GetSchedulerFiber());        // 当前协程退出执行，要将线程正在执行的协程修改为调度协程
-            if (swapcontext(&context_, &(Scheduler::GetSchedulerFiber()->context_))) {
-                LUWU_ASSERT2(false, "swapcontext error");
-            }
+            context_.switchTo(Scheduler::GetSchedulerFiber()->context_);
         } else {
             SetThis(t_main_fiber.get());                    // 当前协程退出执行，要将线程正在执行的协程修改为主协程
-            // 当前协程栈空间保存在第一个参数里，从第二个参数读出协程占空间恢复执行
-            if (swapcontext(&context_, &(t_main_fiber->context_))) {
-                LUWU_ASSERT2(false, "swapcontext error");
-            }
+            // 当前协程上下文保存在 context_ 里，从主协程的上下文恢复执行
+            context_.switchTo(t_main_fiber->context_);
         }
     }
 
-    void Fiber::resume() {
-        LUWU_ASSERT(state_ == READY);
+    bool Fiber::resume() {
+        // 同一个协程只能被一个线程恢复，用 CAS 取得执行权；直接 resume 的协程可能同时被唤醒为 QUEUED，需要重试
+        State state = state_.load(std::memory_order_acquire);
+        do {
+            LUWU_ASSERT(state == READY || state == QUEUED || state == SUSPENDED);
+        } while (!state_.compare_exchange_weak(state, RUNNING, std::memory_order_acq_rel));
 
+        if (shared_stack_) {
+            switchInSharedStack();
+        }
         SetThis(this);                                  // 当前协程需要恢复执行，要将线程正在执行的协程修改为当前协程
-        state_ = RUNNING;
         if (run_in_scheduler_) {
-            if (swapcontext(&(Scheduler::GetSchedulerFiber()->context_), &context_)) {
-                LUWU_ASSERT2(false, "swapcontext error");
-            }
+            Scheduler::GetSchedulerFiber()->context_.switchTo(context_);
         } else {
-            // 当前协程栈空间保存在第一个参数里，从第二个参数读出协程占空间恢复执行
-            if (swapcontext(&(t_main_fiber->context_), &context_)) {
-                LUWU_ASSERT2(false, "swapcontext error");
+            // 主协程的上下文保存在主协程的 context_ 里，从当前协程的上下文恢复执行
+            t_main_fiber->context_.switchTo(context_);
+        }
+
+        // 协程已经完全切换出去，从这里开始才允许其他线程恢复它
+        state = SUSPENDING;
+        if (state_.compare_exchange_strong(state, SUSPENDED, std::memory_order_acq_rel)) {
+            return false;
+        }
+        if (state == NOTIFIED) {
+            state_.store(READY, std::memory_order_release);
+            return true;
+        }
+        return false;
+    }
+
+    bool Fiber::wake(uint32_t tid) {
+        State state = state_.load(std::memory_order_acquire);
+        while (true) {
+            switch (state) {
+                case RUNNING:
+                case SUSPENDING:
+                    // 还没有切换出去，连同指定的线程一起记录下来，由 resume 的调用者重新调度。
+                    // 线程先于状态写入，resume 看到 NOTIFIED 时一定能看到它；并发的多次唤醒合并为一次，保留其中一个线程
+                    pending_tid_.store(tid, std::memory_order_relaxed);
+                    if (state_.compare_exchange_weak(state, NOTIFIED, std::memory_order_acq_rel)) {
+                        return false;
+                    }
+                    break;
+                case READY:
+                    // 新建或者 reset 之后第一次调度
+                case SUSPENDED:
+                    if (state_.compare_exchange_weak(state, QUEUED, std::memory_order_acq_rel)) {
+                        return true;
+                    }
+                    break;
+                default:
+                    // QUEUED、NOTIFIED：已经有一次唤醒在等待处理；TERM：已经结束，不能再调度
+                    return false;
             }
         }
     }
 
+    void Fiber::setLocal(uint32_t slot, void *value, local_deleter deleter) {
+        LUWU_ASSERT(slot < MAX_LOCALS);
+        auto &local = locals_[slot];
+        if (local.value_ && local.deleter_) {
+            local.deleter_(local.value_);
+        }
+        local.value_ = value;
+        local.deleter_ = deleter;
+    }
+
+    void Fiber::clearLocals() {
+        for (auto &local : locals_) {
+            if (local.value_ && local.deleter_) {
+                local.deleter_(local.value_);
+            }
+            local.value_ = nullptr;
+            local.deleter_ = nullptr;
+        }
+    }
+
+    void Fiber::switchInSharedStack() {
+        // 只能在拥有独立栈的协程（调度协程、主协程）中切换共享栈，否则拷贝时会覆盖自己正在使用的栈
+        LUWU_ASSERT(!t_thread_fiber->shared_stack_);
+
+        if (bound_tid_ == static_cast<uint32_t>(-1)) {
+            bound_tid_ = getThreadId();
+        }
+
+        SharedStack &shared = t_shared_stack;
+        char *top = shared.top();
+        if (shared.occupant_ == this) {
+            return;
+        }
+
+        // 把当前占用共享栈的协程用到的部分拷贝到它自己的保存区
+        if (shared.occupant_) {
+            Fiber *occupant = shared.occupant_;
+            auto *sp = static_cast<char *>(occupant->context_.getStackPointer());
+            if (!sp) {
+                sp = static_cast<char *>(shared.stack_);
+            }
+            occupant->saved_stack_.assign(sp, top);
+        }
+        shared.occupant_ = this;
+
+        if (!shared_started_) {
+            shared_started_ = true;
+            context_.make(shared.stack_, s_shared_stack_size, &Fiber::MainFunc);
+        } else {
+            // 恢复之前拷贝出去的栈内容，栈地址与切换出去时完全相同，栈上的指针依然有效
+            memcpy(top - saved_stack_.size(), saved_stack_.data(), saved_stack_.size());
+        }
+    }
+
     void Fiber::InitMainFiber() {
         t_main_fiber = Fiber::ptr(new Fiber);           // 创建主协程
         LUWU_ASSERT(t_main_fiber);                         // 现在有主协程了
@@ -144,6 +266,10 @@ namespace luwu {
         return t_thread_fiber->shared_from_this();
     }
 
+    Fiber *Fiber::GetCurrent() {
+        return t_thread_fiber;
+    }
+
     uint32_t Fiber::GetFiberId() {
         if (!t_thread_fiber) {
             return -1;
@@ -155,13 +281,25 @@ namespace luwu {
         return s_fiber_num;
     }
 
+    uint32_t Fiber::AllocLocalSlot() {
+        uint32_t slot = s_local_slot_num++;
+        LUWU_ASSERT2(slot < MAX_LOCALS, "too many FiberLocal, MAX_LOCALS = " << MAX_LOCALS);
+        return slot;
+    }
+
     void Fiber::MainFunc() {
         auto cur = GetThis();
         LUWU_ASSERT(cur);
 
         cur->func_();
         cur->func_ = nullptr;
-        cur->state_ = TERM;
+        cur->clearLocals();                 // 协程局部变量的生命周期到协程执行结束为止
+        cur->state_.store(TERM, std::memory_order_release);
+        if (cur->shared_stack_) {
+            // 已经结束的协程不再需要保存栈内容，直接让出共享栈
+            t_shared_stack.occupant_ = nullptr;
+            cur->saved_stack_.clear();
+        }
 
         auto raw_ptr = cur.get();
         cur.reset();                        // 手动让引用计数减一
@@ -5,10 +5,13 @@
 #ifndef LUWU_FIBER_H
 #define LUWU_FIBER_H
 
-#include <ucontext.h>
+#include <atomic>
 #include <memory>
-#include <functional>
+#include <vector>
+#include <string>
+#include "context.h"
 #include "utils/noncopyable.h"
+#include "utils/inplace_function.h"
 
 namespace luwu {
     /**
@@ -19,25 +22,71 @@ namespace luwu {
         using ptr = std::shared_ptr<Fiber>;
 
         /**
-         * @brief 协程内需要执行的任务
+         * @brief 协程内需要执行的任务，只能移动，较小的函数对象不分配内存
          */
-        using fiber_func = std::function<void()>;
+        using fiber_func = task_func;
 
         /**
-         * @brief 协程执行状态，就绪态、运行态、结束态
+         * @brief 协程执行状态
+         * @details 状态转换：READY -> QUEUED -> RUNNING -> SUSPENDING -> SUSPENDED -> QUEUED。yield 开始时进入 SUSPENDING，
+         * 上下文切换完成之后由 resume 改为 SUSPENDED，之后才能被唤醒重新调度。唤醒把 READY 或 SUSPENDED 改为 QUEUED，
+         * 已经在队列中（QUEUED）、已经记录了唤醒（NOTIFIED）或者已经结束（TERM）时的唤醒被忽略，协程在队列中最多只有一份。
+         * RUNNING 或 SUSPENDING 时到来的唤醒改为 NOTIFIED 记录下来，切换完成之后由 resume 的调用者立即重新调度，
+         * 唤醒不会丢失，任务也不会在切换完成前被其他线程执行
          */
         enum State {
+            /// 就绪，新建或者 reset 之后还没有被调度过，可以被 resume
             READY,
+            /// 已经被唤醒放入任务队列，等待 resume
+            QUEUED,
+            /// 正在运行
             RUNNING,
+            /// 正在 yield，上下文还没有切换完成
+            SUSPENDING,
+            /// 已经切换出去，等待唤醒
+            SUSPENDED,
+            /// 运行中或者正在 yield 时被唤醒，切换完成之后需要重新调度
+            NOTIFIED,
+            /// 执行结束
             TERM,
         };
 
+        /**
+         * @brief 协程栈大小预设值，小栈用于定时器回调等简单任务，大栈用于调用层次很深的业务处理
+         */
+        enum StackSize : uint32_t {
+            STACK_SMALL = 32 * 1024,
+            STACK_DEFAULT = 128 * 1024,
+            STACK_LARGE = 1024 * 1024,
+        };
+
+        /**
+         * @brief 每个协程最多可以拥有的协程局部变量数量
+         */
+        static const uint32_t MAX_LOCALS = 16;
+
+        /**
+         * @brief 直接保存在协程对象内、不需要在堆上分配的协程局部变量的最大大小
+         */
+        static const size_t LOCAL_INLINE_SIZE = 2 * sizeof(void *);
+
+        /**
+         * @brief 协程局部变量的析构函数
+         */
+        using local_deleter = void (*)(void *);
+
         /**
          * @brief 构造函数
          * @param func 协程内需要执行的任务
          * @param run_in_scheduler 本协程是否接受协程调度器调度
+         * @param stack_size 协程栈大小，为 0 时使用 STACK_DEFAULT
+         * @param shared_stack 是否运行在线程共享栈上，为 true 时忽略 stack_size
+         * @details 共享栈协程切换出去时只把用到的栈拷贝到自己的保存区，大量空闲协程时内存占用很小，
+         * 但是栈地址是线程相关的，第一次运行之后该协程只能在同一个线程上恢复执行，
+         * 并且不能把栈上变量的地址交给其他协程使用
          */
-        explicit Fiber(fiber_func func, bool run_in_scheduler = true);
+        explicit Fiber(fiber_func func, bool run_in_scheduler = true, uint32_t stack_size = STACK_DEFAULT,
+                       bool shared_stack = false);
 
         /**
          * @brief 析构函数
@@ -57,19 +106,99 @@ namespace luwu {
 
         /**
          * @brief 恢复该线程的执行权，在主协程被调用
+         * @return 协程 yield 期间是否被唤醒过，为 true 时协程已经回到 READY，调用者需要把它重新放入调度器
+         */
+        bool resume();
+
+        /**
+         * @brief 唤醒协程，调度器把协程放入任务队列之前调用
+         * @param tid 唤醒者指定协程在哪个线程上恢复执行，-1 表示不指定
+         * @return 是否可以放入任务队列；协程还在运行或者正在切换出去时返回 false，唤醒连同 tid 被记录下来，
+         * 由 resume 的调用者按 getPendingThread 重新调度；协程已经在队列中、已经记录了唤醒或者已经结束时也返回 false
          */
-        void resume();
+        bool wake(uint32_t tid = -1);
 
-        // region # Getter
+        // region # Getter and Setter
         uint32_t getId() const {
             return id_;
         }
 
         State getState() const {
-            return state_;
+            return state_.load(std::memory_order_acquire);
+        }
+
+        uint32_t getStackSize() const {
+            return stack_size_;
+        }
+
+        bool isSharedStack() const {
+            return shared_stack_;
+        }
+
+        bool isRunInScheduler() const {
+            return run_in_scheduler_;
+        }
+
+        uint32_t getBoundThread() const {
+            return bound_tid_;
+        }
+
+        /**
+         * @brief 运行中或者正在 yield 时被唤醒，唤醒者指定的线程，resume 返回 true 之后按它重新调度
+         */
+        uint32_t getPendingThread() const {
+            return pending_tid_.load(std::memory_order_relaxed);
+        }
+
+        uint8_t getPriority() const {
+            return priority_;
+        }
+
+        /**
+         * @brief 设置协程的调度优先级，协程之后每次被唤醒（IO 就绪、sleep 结束、锁释放等）都按该优先级重新调度
+         * @param priority 优先级，取值见 Scheduler::Priority
+         */
+        void setPriority(uint8_t priority) {
+            priority_ = priority;
+        }
+
+        const std::string &getName() const {
+            return name_;
+        }
+
+        /**
+         * @brief 设置协程正在处理的业务名称，例如 servlet 名称，调度器的看门狗报告超时的协程时一起输出
+         * @param name 名称，协程执行结束后被重用时清空
+         */
+        void setName(const std::string &name) {
+            name_ = name;
+        }
+
+        void *getLocal(uint32_t slot) const {
+            return locals_[slot].value_;
+        }
+
+        /**
+         * @brief 槽位内保存小对象的空间，大小为 LOCAL_INLINE_SIZE，按指针对齐
+         */
+        void *getLocalStorage(uint32_t slot) {
+            return locals_[slot].storage_;
         }
         // endregion
 
+        /**
+         * @brief 设置协程局部变量，槽位上原有的值会被析构
+         * @param slot 槽位，由 AllocLocalSlot 分配
+         * @param value 值
+         * @param deleter 值的析构函数
+         */
+        void setLocal(uint32_t slot, void *value, local_deleter deleter);
+
+        /**
+         * @brief 析构所有协程局部变量，协程执行结束和重置时调用
+         */
+        void clearLocals();
+
     public:
         static void InitMainFiber();
         /**
@@ -88,6 +217,13 @@ namespace luwu {
          */
         static Fiber::ptr GetThis();
 
+        /**
+         * @brief 获取当前正在运行的协程的裸指针，不增加引用计数
+         * @return 当前正在运行的协程，线程还没有主协程时为 nullptr
+         * @details 只在当前协程内使用、不需要延长协程生命周期的热路径（例如协程局部变量）使用它
+         */
+        static Fiber *GetCurrent();
+
         /**
          * @brief 获取当前正在运行的协程的 id
          * @return 当前正在运行的协程的 id
@@ -100,6 +236,12 @@ namespace luwu {
          */
         static uint32_t TotalFibers();
 
+        /**
+         * @brief 分配一个协程局部变量槽位，所有协程共用同一套槽位编号
+         * @return 槽位编号
+         */
+        static uint32_t AllocLocalSlot();
+
         /**
          * @brief 协程入口函数，在本函数内调用构造函数内传入的 func
          */
@@ -112,21 +254,47 @@ namespace luwu {
          */
         Fiber();
 
+        /**
+         * @brief 共享栈协程恢复执行之前，把共享栈的占用者切换为本协程
+         * @details 先把原占用者用到的栈拷贝出去，再把本协程保存的栈拷贝回来，或者在共享栈上构造初始上下文
+         */
+        void switchInSharedStack();
+
     private:
         /// 协程 id
         uint32_t id_;
         /// 协程运行状态
-        State state_;
+        std::atomic<State> state_;
         /// 协程内实际执行的函数
         fiber_func func_;
         /// 协程上下文
-        ucontext_t context_{};
+        Context context_;
         /// 协程栈大小
         uint32_t stack_size_;
         /// 协程栈地址
         void *stack_{};
         /// 是否参与协程调度器调度
         bool run_in_scheduler_;
+        /// 是否运行在线程共享栈上
+        bool shared_stack_;
+        /// 共享栈协程是否已经在共享栈上构造过上下文
+        bool shared_started_;
+        /// 共享栈协程第一次运行所在的线程，之后只能在这个线程上恢复执行
+        uint32_t bound_tid_;
+        /// 进入 NOTIFIED 的那次唤醒指定的线程，在状态切换之前写入，随状态一起发布
+        std::atomic_uint32_t pending_tid_;
+        /// 调度优先级，取值见 Scheduler::Priority，默认为 NORMAL
+        uint8_t priority_;
+        /// 协程正在处理的业务名称
+        std::string name_;
+        /// 共享栈协程切换出去时保存的栈内容
+        std::vector<char> saved_stack_;
+        /// 协程局部变量，按槽位直接索引；value_ 为 nullptr 表示没有值，小对象的 value_ 指向 storage_
+        struct {
+            void *value_ = nullptr;
+            local_deleter deleter_ = nullptr;
+            alignas(void *) unsigned char storage_[LOCAL_INLINE_SIZE];
+        } locals_[MAX_LOCALS];
     };
 }
 
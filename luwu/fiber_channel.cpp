@@ -0,0 +1,84 @@
+//
+// Created by liucxi on 2022/12/8.
+//
+
+#include "fiber_channel.h"
+#include "scheduler.h"
+#include "utils/asserts.h"
+
+namespace luwu {
+
+    FiberSelectState::FiberSelectState() : fired_(-1), scheduler_(Scheduler::GetThis()) {
+        // 先检查再取当前协程，不在任何协程中时 Fiber::GetThis 本身就会崩溃
+        LUWU_ASSERT2(Scheduler::InTaskFiber(), "fiber channel must wait in a fiber run by a scheduler");
+        fiber_ = Fiber::GetThis();
+    }
+
+    void FiberSelectState::wake() {
+        scheduler_->addTask(fiber_);
+    }
+
+    void FiberSelectState::park() {
+        // 唤醒者可能在本协程真正 yield 之前就把它加入了调度器：这时协程还是 RUNNING 或者 SUSPENDING，
+        // 唤醒只把状态改为 NOTIFIED，不会入队；切换完成后 resume 看到 NOTIFIED 返回 true，由调度线程重新调度，所以这里不需要额外处理
+        // fiber_ 一直持有协程的引用，不需要像 FiberWaitQueue 那样手动减少引用计数
+        fiber_->yield();
+    }
+
+    int FiberSelect::select(bool block) {
+        LUWU_ASSERT2(!cases_.empty(), "select without case");
+
+        lockAll();
+        for (size_t i = 0; i < cases_.size(); ++i) {
+            if (cases_[i]->tryLocked()) {
+                unlockAll();
+                cases_[i]->complete();
+                return static_cast<int>(i);
+            }
+        }
+        if (!block) {
+            unlockAll();
+            return -1;
+        }
+
+        // 所有 channel 都锁住时注册，其他协程不可能在注册完成之前让某个分支生效
+        auto state = std::make_shared<FiberSelectState>();
+        for (size_t i = 0; i < cases_.size(); ++i) {
+            cases_[i]->enqueueLocked(state, static_cast<int>(i));
+        }
+        unlockAll();
+        state->park();
+
+        // 生效分支的等待者已经被对方取走，其余分支的等待者需要移除，避免一直占用内存
+        int fired = state->getFired();
+        LUWU_ASSERT(fired >= 0);
+        lockAll();
+        for (size_t i = 0; i < cases_.size(); ++i) {
+            if (static_cast<int>(i) != fired) {
+                cases_[i]->dequeueLocked();
+            }
+        }
+        unlockAll();
+        cases_[fired]->complete();
+        return fired;
+    }
+
+    void FiberSelect::lockAll() {
+        if (guards_.empty()) {
+            for (auto &c : cases_) {
+                guards_.push_back(c->guard());
+            }
+            std::sort(guards_.begin(), guards_.end());
+            guards_.erase(std::unique(guards_.begin(), guards_.end()), guards_.end());
+        }
+        for (auto guard : guards_) {
+            guard->lock();
+        }
+    }
+
+    void FiberSelect::unlockAll() {
+        for (auto it = guards_.rbegin(); it != guards_.rend(); ++it) {
+            (*it)->unlock();
+        }
+    }
+}
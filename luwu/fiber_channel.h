@@ -0,0 +1,549 @@
+//
+// Created by liucxi on 2022/12/8.
+//
+
+#ifndef LUWU_FIBER_CHANNEL_H
+#define LUWU_FIBER_CHANNEL_H
+
+#include <list>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include "fiber.h"
+#include "utils/mutex.h"
+#include "utils/noncopyable.h"
+
+namespace luwu {
+    class Scheduler;
+    class FiberSelect;
+
+    /**
+     * @brief 一次阻塞的 channel 操作（或者一次 select）的等待状态
+     * @details 同一次 select 在多个 channel 上的等待者共享同一个状态，只有第一个 claim 成功的操作生效，
+     * 其余 channel 上的等待者自动作废
+     */
+    class FiberSelectState : NonCopyable {
+    public:
+        using ptr = std::shared_ptr<FiberSelectState>;
+
+        /**
+         * @brief 构造函数，记录当前协程以及唤醒时把它放回哪个调度器
+         */
+        FiberSelectState();
+
+        /**
+         * @brief 尝试让第 index 个操作生效
+         * @param index 操作编号
+         * @return 是否成功，已经有其他操作生效时返回 false
+         */
+        bool claim(int index) {
+            int expect = -1;
+            return fired_.compare_exchange_strong(expect, index);
+        }
+
+        /**
+         * @brief 获取生效的操作编号
+         * @return 操作编号，还没有操作生效时为 -1
+         */
+        int getFired() const {
+            return fired_;
+        }
+
+        /**
+         * @brief 重新调度等待的协程
+         */
+        void wake();
+
+        /**
+         * @brief 挂起当前协程，直到被 wake
+         */
+        void park();
+
+    private:
+        /// 生效的操作编号
+        std::atomic<int> fired_;
+        /// 等待协程所在的调度器
+        Scheduler *scheduler_;
+        /// 等待的协程
+        Fiber::ptr fiber_;
+    };
+
+    /**
+     * @brief 协程间通信的 channel，类似 Go 的 chan
+     * @tparam T 元素类型，需要可默认构造、可移动
+     * @details 阻塞时挂起的是协程而不是线程。缓冲区是环形数组；有协程在等待时，数据直接交给等待者（per-waiter handoff），
+     * 不经过缓冲区。容量为 0 时是无缓冲 channel，发送方和接收方必须配对；容量为 UNBOUNDED 时缓冲区按需扩容，发送永远不会阻塞
+     */
+    template<typename T>
+    class FiberChannel : NonCopyable {
+        friend class FiberSelect;
+
+    public:
+        using ptr = std::shared_ptr<FiberChannel>;
+        using value_type = T;
+        using recv_callback = std::function<void(T value, bool ok)>;
+        using send_callback = std::function<void(bool ok)>;
+
+        /// 无界 channel 的容量
+        static const size_t UNBOUNDED = static_cast<size_t>(-1);
+
+        /**
+         * @brief 构造函数
+         * @param capacity 缓冲区容量
+         */
+        explicit FiberChannel(size_t capacity = 0)
+            : capacity_(capacity), head_(0), size_(0), closed_(false) {
+            if (capacity_ != 0 && capacity_ != UNBOUNDED) {
+                buffer_.resize(capacity_);
+            }
+        }
+
+        /**
+         * @brief 发送数据，缓冲区满时挂起当前协程
+         * @param value 数据
+         * @return 是否发送成功，channel 已经关闭时返回 false
+         */
+        bool send(T value) {
+            SpinLock::Lock lock(guard_);
+            bool ok = false;
+            FiberSelectState::ptr wake;
+            if (trySendLocked(value, ok, wake)) {
+                lock.unlock();
+                if (wake) {
+                    wake->wake();
+                }
+                return ok;
+            }
+
+            auto state = std::make_shared<FiberSelectState>();
+            auto waiter = enqueueLocked(send_waiters_, state, 0);
+            waiter->value_ = std::move(value);
+            lock.unlock();
+            state->park();
+            return waiter->ok_;
+        }
+
+        /**
+         * @brief 接收数据，没有数据时挂起当前协程
+         * @param value 接收到的数据
+         * @return 是否接收成功，channel 已经关闭并且没有剩余数据时返回 false
+         */
+        bool recv(T &value) {
+            SpinLock::Lock lock(guard_);
+            bool ok = false;
+            FiberSelectState::ptr wake;
+            if (tryRecvLocked(value, ok, wake)) {
+                lock.unlock();
+                if (wake) {
+                    wake->wake();
+                }
+                return ok;
+            }
+
+            auto state = std::make_shared<FiberSelectState>();
+            auto waiter = enqueueLocked(recv_waiters_, state, 0);
+            lock.unlock();
+            state->park();
+            if (waiter->ok_) {
+                value = std::move(waiter->value_);
+            }
+            return waiter->ok_;
+        }
+
+        /**
+         * @brief 尝试发送数据，不挂起
+         * @param value 数据，只有发送成功时才会被移走
+         * @return 是否发送成功
+         */
+        bool trySend(T &value) {
+            SpinLock::Lock lock(guard_);
+            bool ok = false;
+            FiberSelectState::ptr wake;
+            if (!trySendLocked(value, ok, wake)) {
+                return false;
+            }
+            lock.unlock();
+            if (wake) {
+                wake->wake();
+            }
+            return ok;
+        }
+
+        /**
+         * @brief 尝试接收数据，不挂起
+         * @param value 接收到的数据
+         * @return 是否接收成功
+         */
+        bool tryRecv(T &value) {
+            SpinLock::Lock lock(guard_);
+            bool ok = false;
+            FiberSelectState::ptr wake;
+            if (!tryRecvLocked(value, ok, wake)) {
+                return false;
+            }
+            lock.unlock();
+            if (wake) {
+                wake->wake();
+            }
+            return ok;
+        }
+
+        /**
+         * @brief 关闭 channel，唤醒所有等待者，之后的发送都会失败，接收在取完剩余数据之后失败
+         */
+        void close() {
+            std::vector<FiberSelectState::ptr> wakes;
+            {
+                SpinLock::Lock lock(guard_);
+                closed_ = true;
+                for (auto list : {&recv_waiters_, &send_waiters_}) {
+                    WaiterPtr waiter;
+                    while ((waiter = popWaiterLocked(*list))) {
+                        waiter->ok_ = false;
+                        wakes.push_back(waiter->state_);
+                    }
+                }
+            }
+            for (auto &state : wakes) {
+                state->wake();
+            }
+        }
+
+        // region # Getter
+        bool isClosed() {
+            SpinLock::Lock lock(guard_);
+            return closed_;
+        }
+
+        size_t size() {
+            SpinLock::Lock lock(guard_);
+            return size_;
+        }
+
+        size_t getCapacity() const {
+            return capacity_;
+        }
+        // endregion
+
+    private:
+        /**
+         * @brief 挂起在 channel 上的等待者，发送方的数据和接收方收到的数据都保存在这里，而不是等待协程的栈上
+         */
+        struct Waiter {
+            /// 等待状态
+            FiberSelectState::ptr state_;
+            /// 在所属 select 中的操作编号
+            int index_;
+            /// 数据
+            T value_;
+            /// 操作是否成功
+            bool ok_;
+        };
+
+        using WaiterPtr = std::shared_ptr<Waiter>;
+
+        bool fullLocked() const {
+            return capacity_ != UNBOUNDED && size_ >= capacity_;
+        }
+
+        void pushLocked(T &&value) {
+            if (size_ == buffer_.size()) {
+                // 只有无界 channel 会走到这里，按两倍扩容并把环形数组展开
+                std::vector<T> buffer(std::max<size_t>(16, buffer_.size() * 2));
+                for (size_t i = 0; i < size_; ++i) {
+                    buffer[i] = std::move(buffer_[(head_ + i) % buffer_.size()]);
+                }
+                buffer_.swap(buffer);
+                head_ = 0;
+            }
+            buffer_[(head_ + size_) % buffer_.size()] = std::move(value);
+            ++size_;
+        }
+
+        T popLocked() {
+            T value = std::move(buffer_[head_]);
+            head_ = (head_ + 1) % buffer_.size();
+            --size_;
+            return value;
+        }
+
+        /**
+         * @brief 取出第一个仍然有效的等待者，已经在其他 channel 上生效的等待者直接丢弃
+         */
+        static WaiterPtr popWaiterLocked(std::list<WaiterPtr> &waiters) {
+            while (!waiters.empty()) {
+                WaiterPtr waiter = std::move(waiters.front());
+                waiters.pop_front();
+                if (waiter->state_->claim(waiter->index_)) {
+                    return waiter;
+                }
+            }
+            return nullptr;
+        }
+
+        static WaiterPtr enqueueLocked(std::list<WaiterPtr> &waiters, const FiberSelectState::ptr &state, int index) {
+            WaiterPtr waiter(new Waiter{state, index, T(), false});
+            waiters.push_back(waiter);
+            return waiter;
+        }
+
+        /**
+         * @brief 持有锁时尝试立即发送
+         * @param value 数据，只有操作完成时才会被移走
+         * @param ok 操作结果
+         * @param wake 需要在释放锁之后唤醒的等待者
+         * @return 操作是否完成（包括因为 channel 已关闭而失败）
+         */
+        bool trySendLocked(T &value, bool &ok, FiberSelectState::ptr &wake) {
+            if (closed_) {
+                ok = false;
+                return true;
+            }
+            WaiterPtr receiver = popWaiterLocked(recv_waiters_);
+            if (receiver) {
+                receiver->value_ = std::move(value);
+                receiver->ok_ = true;
+                wake = receiver->state_;
+                ok = true;
+                return true;
+            }
+            if (!fullLocked()) {
+                pushLocked(std::move(value));
+                ok = true;
+                return true;
+            }
+            return false;
+        }
+
+        /**
+         * @brief 持有锁时尝试立即接收
+         * @param value 接收到的数据
+         * @param ok 操作结果
+         * @param wake 需要在释放锁之后唤醒的等待者
+         * @return 操作是否完成（包括因为 channel 已关闭而失败）
+         */
+        bool tryRecvLocked(T &value, bool &ok, FiberSelectState::ptr &wake) {
+            if (size_ > 0) {
+                value = popLocked();
+                ok = true;
+                // 缓冲区腾出了位置，把一个等待的发送者的数据放进来
+                WaiterPtr sender = popWaiterLocked(send_waiters_);
+                if (sender) {
+                    pushLocked(std::move(sender->value_));
+                    sender->ok_ = true;
+                    wake = sender->state_;
+                }
+                return true;
+            }
+            WaiterPtr sender = popWaiterLocked(send_waiters_);
+            if (sender) {
+                value = std::move(sender->value_);
+                sender->ok_ = true;
+                wake = sender->state_;
+                ok = true;
+                return true;
+            }
+            if (closed_) {
+                ok = false;
+                return true;
+            }
+            return false;
+        }
+
+    private:
+        SpinLock guard_;
+        /// 缓冲区容量
+        size_t capacity_;
+        /// 环形缓冲区
+        std::vector<T> buffer_;
+        /// 环形缓冲区头部下标
+        size_t head_;
+        /// 缓冲区中的数据数量
+        size_t size_;
+        /// 是否已经关闭
+        bool closed_;
+        /// 等待接收的协程
+        std::list<WaiterPtr> recv_waiters_;
+        /// 等待发送的协程
+        std::list<WaiterPtr> send_waiters_;
+    };
+
+    /**
+     * @brief 在多个 channel 操作上等待，第一个可以完成的操作生效，类似 Go 的 select
+     * @details 用法：FiberSelect().recv(ch1, cb1).send(ch2, value, cb2).wait()
+     * 检查和注册时按地址顺序锁住所有涉及的 channel，所以同一个 channel 可以出现在多个分支中
+     */
+    class FiberSelect : NonCopyable {
+    public:
+        FiberSelect() = default;
+
+        /**
+         * @brief 添加一个接收分支
+         * @param channel channel
+         * @param callback 该分支生效时的回调，参数为接收到的数据和是否成功
+         * @return 自身，用于链式调用
+         */
+        template<typename T>
+        FiberSelect &recv(FiberChannel<T> &channel, typename FiberChannel<T>::recv_callback callback = nullptr) {
+            cases_.emplace_back(new RecvCase<T>(channel, std::move(callback)));
+            return *this;
+        }
+
+        /**
+         * @brief 添加一个发送分支
+         * @param channel channel
+         * @param value 需要发送的数据，该分支没有生效时数据被丢弃
+         * @param callback 该分支生效时的回调，参数为是否成功
+         * @return 自身，用于链式调用
+         */
+        template<typename T>
+        FiberSelect &send(FiberChannel<T> &channel, typename FiberChannel<T>::value_type value,
+                          typename FiberChannel<T>::send_callback callback = nullptr) {
+            cases_.emplace_back(new SendCase<T>(channel, std::move(value), std::move(callback)));
+            return *this;
+        }
+
+        /**
+         * @brief 等待任意一个分支生效，没有分支可以立即完成时挂起当前协程
+         * @return 生效的分支编号，按添加顺序从 0 开始
+         */
+        int wait() {
+            return select(true);
+        }
+
+        /**
+         * @brief 尝试让一个分支立即生效，不挂起，相当于带 default 分支的 select
+         * @return 生效的分支编号，没有分支可以立即完成时返回 -1
+         */
+        int tryWait() {
+            return select(false);
+        }
+
+    private:
+        /**
+         * @brief select 的一个分支
+         */
+        struct Case {
+            virtual ~Case() = default;
+
+            /// 所在 channel 的锁
+            virtual SpinLock *guard() = 0;
+
+            /// 持有锁时尝试立即完成
+            virtual bool tryLocked() = 0;
+
+            /// 持有锁时注册等待者
+            virtual void enqueueLocked(const FiberSelectState::ptr &state, int index) = 0;
+
+            /// 持有锁时移除没有生效的等待者
+            virtual void dequeueLocked() = 0;
+
+            /// 释放所有锁之后调用，唤醒对方并执行回调
+            virtual void complete() = 0;
+        };
+
+        template<typename T>
+        struct RecvCase : Case {
+            RecvCase(FiberChannel<T> &channel, std::function<void(T, bool)> callback)
+                : channel_(channel), callback_(std::move(callback)) {}
+
+            SpinLock *guard() override { return &channel_.guard_; }
+
+            bool tryLocked() override {
+                return channel_.tryRecvLocked(value_, ok_, wake_);
+            }
+
+            void enqueueLocked(const FiberSelectState::ptr &state, int index) override {
+                waiter_ = FiberChannel<T>::enqueueLocked(channel_.recv_waiters_, state, index);
+            }
+
+            void dequeueLocked() override {
+                channel_.recv_waiters_.remove(waiter_);
+            }
+
+            void complete() override {
+                if (wake_) {
+                    wake_->wake();
+                }
+                if (waiter_) {
+                    ok_ = waiter_->ok_;
+                    value_ = std::move(waiter_->value_);
+                }
+                if (callback_) {
+                    callback_(std::move(value_), ok_);
+                }
+            }
+
+            FiberChannel<T> &channel_;
+            std::function<void(T, bool)> callback_;
+            typename FiberChannel<T>::WaiterPtr waiter_;
+            FiberSelectState::ptr wake_;
+            T value_{};
+            bool ok_ = false;
+        };
+
+        template<typename T>
+        struct SendCase : Case {
+            SendCase(FiberChannel<T> &channel, T value, std::function<void(bool)> callback)
+                : channel_(channel), callback_(std::move(callback)), value_(std::move(value)) {}
+
+            SpinLock *guard() override { return &channel_.guard_; }
+
+            bool tryLocked() override {
+                return channel_.trySendLocked(value_, ok_, wake_);
+            }
+
+            void enqueueLocked(const FiberSelectState::ptr &state, int index) override {
+                waiter_ = FiberChannel<T>::enqueueLocked(channel_.send_waiters_, state, index);
+                waiter_->value_ = std::move(value_);
+            }
+
+            void dequeueLocked() override {
+                channel_.send_waiters_.remove(waiter_);
+            }
+
+            void complete() override {
+                if (wake_) {
+                    wake_->wake();
+                }
+                if (waiter_) {
+                    ok_ = waiter_->ok_;
+                }
+                if (callback_) {
+                    callback_(ok_);
+                }
+            }
+
+            FiberChannel<T> &channel_;
+            std::function<void(bool)> callback_;
+            typename FiberChannel<T>::WaiterPtr waiter_;
+            FiberSelectState::ptr wake_;
+            T value_;
+            bool ok_ = false;
+        };
+
+        /**
+         * @brief select 的具体实现
+         * @param block 没有分支可以立即完成时是否挂起
+         * @return 生效的分支编号
+         */
+        int select(bool block);
+
+        /**
+         * @brief 按地址顺序锁住所有涉及的 channel，避免与其他 select 死锁
+         */
+        void lockAll();
+
+        void unlockAll();
+
+    private:
+        /// 所有分支
+        std::vector<std::unique_ptr<Case>> cases_;
+        /// 去重并排序之后的 channel 锁
+        std::vector<SpinLock *> guards_;
+    };
+}
+
+#endif //LUWU_FIBER_CHANNEL_H
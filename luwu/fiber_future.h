@@ -0,0 +1,181 @@
+//
+// Created by liucxi on 2022/12/8.
+//
+
+#ifndef LUWU_FIBER_FUTURE_H
+#define LUWU_FIBER_FUTURE_H
+
+#include <memory>
+#include <utility>
+#include "fiber_sync.h"
+#include "utils/asserts.h"
+#include "utils/noncopyable.h"
+
+namespace luwu {
+    /**
+     * @brief Promise 与 Future 之间共享的状态
+     * @tparam T 结果类型，需要可默认构造
+     */
+    template<typename T>
+    class FutureState : NonCopyable {
+    public:
+        using ptr = std::shared_ptr<FutureState>;
+
+        /**
+         * @brief 设置结果并唤醒所有等待的协程，只能设置一次
+         * @param value 结果
+         */
+        void set(T value) {
+            SpinLock::Lock lock(guard_);
+            LUWU_ASSERT2(!ready_, "promise already satisfied");
+            value_ = std::move(value);
+            ready_ = true;
+            waiters_.notifyAll(lock);
+        }
+
+        /**
+         * @brief 挂起当前协程直到结果就绪
+         */
+        void wait() {
+            SpinLock::Lock lock(guard_);
+            if (ready_) {
+                return;
+            }
+            waiters_.push();
+            lock.unlock();
+            FiberWaitQueue::Park();
+        }
+
+        const T &get() {
+            wait();
+            // 结果就绪之后不会再被修改，可以不加锁读取
+            return value_;
+        }
+
+        bool isReady() {
+            SpinLock::Lock lock(guard_);
+            return ready_;
+        }
+
+    private:
+        SpinLock guard_;
+        /// 结果是否已经就绪
+        bool ready_ = false;
+        /// 结果
+        T value_{};
+        /// 等待结果的协程
+        FiberWaitQueue waiters_;
+    };
+
+    /**
+     * @brief 没有结果的共享状态，只表示完成
+     */
+    template<>
+    class FutureState<void> : public FutureState<bool> {
+    public:
+        using ptr = std::shared_ptr<FutureState>;
+
+        void set() {
+            FutureState<bool>::set(true);
+        }
+
+        void get() {
+            wait();
+        }
+    };
+
+    /**
+     * @brief 异步结果的读取端，可以拷贝，多个协程可以同时等待同一个结果
+     * @tparam T 结果类型
+     * @details get 只挂起当前协程，不阻塞线程，必须在调度器中的协程里调用
+     */
+    template<typename T>
+    class Future {
+    public:
+        Future() = default;
+
+        explicit Future(typename FutureState<T>::ptr state) : state_(std::move(state)) {}
+
+        /**
+         * @brief 是否关联了共享状态
+         */
+        bool valid() const {
+            return state_ != nullptr;
+        }
+
+        /**
+         * @brief 结果是否已经就绪，不挂起
+         */
+        bool isReady() const {
+            LUWU_ASSERT(state_);
+            return state_->isReady();
+        }
+
+        /**
+         * @brief 挂起当前协程直到结果就绪
+         */
+        void wait() const {
+            LUWU_ASSERT(state_);
+            state_->wait();
+        }
+
+        /**
+         * @brief 获取结果，结果未就绪时挂起当前协程
+         * @return 结果，Future<void> 没有返回值
+         */
+        auto get() const -> decltype(std::declval<FutureState<T>>().get()) {
+            LUWU_ASSERT(state_);
+            return state_->get();
+        }
+
+    private:
+        typename FutureState<T>::ptr state_;
+    };
+
+    /**
+     * @brief 异步结果的写入端，通常交给子任务，子任务完成时设置结果
+     * @tparam T 结果类型
+     */
+    template<typename T>
+    class Promise {
+    public:
+        Promise() : state_(std::make_shared<FutureState<T>>()) {}
+
+        /**
+         * @brief 获取关联的 Future
+         */
+        Future<T> getFuture() const {
+            return Future<T>(state_);
+        }
+
+        /**
+         * @brief 设置结果，唤醒所有等待的协程
+         * @param value 结果
+         */
+        void setValue(T value) const {
+            state_->set(std::move(value));
+        }
+
+    private:
+        typename FutureState<T>::ptr state_;
+    };
+
+    template<>
+    class Promise<void> {
+    public:
+        Promise() : state_(std::make_shared<FutureState<void>>()) {}
+
+        Future<void> getFuture() const {
+            return Future<void>(state_);
+        }
+
+        void setValue() const {
+            state_->set();
+        }
+
+    private:
+        FutureState<void>::ptr state_;
+    };
+}
+
+#endif //LUWU_FIBER_FUTURE_H
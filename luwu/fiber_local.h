@@ -0,0 +1,117 @@
+//
+// Created by liucxi on 2022/12/6.
+//
+
+#ifndef LUWU_FIBER_LOCAL_H
+#define LUWU_FIBER_LOCAL_H
+
+#include <new>
+#include "fiber.h"
+#include "utils/asserts.h"
+#include "utils/noncopyable.h"
+
+namespace luwu {
+    /**
+     * @brief 协程局部变量
+     * @tparam T 变量类型
+     * @details 值保存在协程对象内的槽位数组中，按槽位直接索引，不需要哈希查找；不超过 Fiber::LOCAL_INLINE_SIZE
+     * 的值（整数、指针、小结构体）直接构造在槽位里，更大的值在堆上分配，槽位保存它的指针。
+     * 协程在调度器的不同线程之间迁移时值跟随协程，协程执行结束或者 reset 时自动析构。
+     * 一般定义为全局变量或静态变量，所有 FiberLocal 对象的总数不能超过 Fiber::MAX_LOCALS。
+     * 只能在协程内使用，线程还没有协程时调用会断言失败。直接在调度协程上执行的任务（addInlineTask）使用的是调度协程的槽位，
+     * 值只在该任务执行期间有效，任务返回后由调度器清除，不会泄漏给同一线程上之后执行的任务
+     */
+    template<typename T>
+    class FiberLocal : NonCopyable {
+    public:
+        FiberLocal() : slot_(Fiber::AllocLocalSlot()) {}
+
+        /**
+         * @brief 获取当前协程的值，不存在时默认构造一个
+         * @return 当前协程的值
+         */
+        T *get() {
+            Fiber *fiber = Current();
+            auto value = static_cast<T *>(fiber->getLocal(slot_));
+            if (!value) {
+                value = construct(fiber, T());
+            }
+            return value;
+        }
+
+        /**
+         * @brief 设置当前协程的值
+         * @param value 新的值
+         */
+        void set(T value) {
+            Fiber *fiber = Current();
+            // 先析构原来的值，小对象要在同一块空间上构造
+            fiber->setLocal(slot_, nullptr, nullptr);
+            construct(fiber, std::move(value));
+        }
+
+        /**
+         * @brief 当前协程是否设置过值
+         * @return 是否有值
+         */
+        bool has() const {
+            return Current()->getLocal(slot_) != nullptr;
+        }
+
+        /**
+         * @brief 析构当前协程的值
+         */
+        void reset() {
+            Current()->setLocal(slot_, nullptr, nullptr);
+        }
+
+        T &operator*() { return *get(); }
+
+        T *operator->() { return get(); }
+
+    private:
+        /// 值是否直接保存在槽位里
+        static const bool INLINE = sizeof(T) <= Fiber::LOCAL_INLINE_SIZE && alignof(T) <= alignof(void *);
+
+        /**
+         * @brief 获取当前协程，线程还没有协程时断言失败
+         */
+        static Fiber *Current() {
+            Fiber *fiber = Fiber::GetCurrent();
+            LUWU_ASSERT2(fiber, "FiberLocal must be used in a fiber");
+            return fiber;
+        }
+
+        /**
+         * @brief 在当前协程的空槽位上构造值
+         * @param fiber 当前协程
+         * @param value 值
+         * @return 构造出的值
+         */
+        T *construct(Fiber *fiber, T &&value) {
+            T *result;
+            if (INLINE) {
+                result = new(fiber->getLocalStorage(slot_)) T(std::move(value));
+                fiber->setLocal(slot_, result, &FiberLocal::Destroy);
+            } else {
+                result = new T(std::move(value));
+                fiber->setLocal(slot_, result, &FiberLocal::Delete);
+            }
+            return result;
+        }
+
+        static void Delete(void *value) {
+            delete static_cast<T *>(value);
+        }
+
+        static void Destroy(void *value) {
+            static_cast<T *>(value)->~T();
+        }
+
+    private:
+        /// 槽位编号
+        uint32_t slot_;
+    };
+}
+
+#endif //LUWU_FIBER_LOCAL_H
@@ -0,0 +1,141 @@
+//
+// Created by liucxi on 2022/12/7.
+//
+
+#include "fiber_sync.h"
+#include "scheduler.h"
+#include "utils/asserts.h"
+
+namespace luwu {
+
+    void FiberWaitQueue::push() {
+        LUWU_ASSERT2(Scheduler::InTaskFiber(), "fiber sync primitive must wait in a fiber run by a scheduler");
+        waiters_.push_back({Scheduler::GetThis(), Fiber::GetThis()});
+    }
+
+    void FiberWaitQueue::Park() {
+        // 唤醒者可能在本协程真正 yield 之前就把它加入了调度器：这时协程还是 RUNNING 或者 SUSPENDING，
+        // 唤醒只把状态改为 NOTIFIED，不会入队；切换完成后 resume 看到 NOTIFIED 返回 true，由调度线程重新调度，所以这里不需要额外处理
+        auto cur = Fiber::GetThis();
+        auto raw_ptr = cur.get();
+        cur.reset();                        // 等待队列持有协程的引用，这里手动使引用计数减一
+        raw_ptr->yield();
+    }
+
+    bool FiberWaitQueue::notifyOne(SpinLock::Lock &lock) {
+        if (waiters_.empty()) {
+            return false;
+        }
+        Waiter waiter = std::move(waiters_.front());
+        waiters_.pop_front();
+        lock.unlock();
+        waiter.scheduler_->addTask(waiter.fiber_);
+        return true;
+    }
+
+    void FiberWaitQueue::notifyAll(SpinLock::Lock &lock) {
+        std::list<Waiter> waiters;
+        waiters.swap(waiters_);
+        lock.unlock();
+        for (auto &waiter : waiters) {
+            waiter.scheduler_->addTask(waiter.fiber_);
+        }
+    }
+
+    void FiberMutex::lock() {
+        SpinLock::Lock lock(guard_);
+        if (!locked_) {
+            locked_ = true;
+            return;
+        }
+        waiters_.push();
+        lock.unlock();
+        FiberWaitQueue::Park();
+        // 被唤醒时锁已经由 unlock 直接交给了本协程
+    }
+
+    bool FiberMutex::tryLock() {
+        SpinLock::Lock lock(guard_);
+        if (locked_) {
+            return false;
+        }
+        locked_ = true;
+        return true;
+    }
+
+    void FiberMutex::unlock() {
+        SpinLock::Lock lock(guard_);
+        LUWU_ASSERT(locked_);
+        // 有协程在等待时 locked_ 保持为 true，所有权直接交给被唤醒的协程
+        if (!waiters_.notifyOne(lock)) {
+            locked_ = false;
+        }
+    }
+
+    void FiberCondVar::wait(FiberMutex &mutex) {
+        SpinLock::Lock lock(guard_);
+        waiters_.push();
+        lock.unlock();
+        // 先加入等待队列再释放互斥锁，避免在两者之间发生的 notify 丢失
+        mutex.unlock();
+        FiberWaitQueue::Park();
+        mutex.lock();
+    }
+
+    void FiberCondVar::notifyOne() {
+        SpinLock::Lock lock(guard_);
+        waiters_.notifyOne(lock);
+    }
+
+    void FiberCondVar::notifyAll() {
+        SpinLock::Lock lock(guard_);
+        waiters_.notifyAll(lock);
+    }
+
+    void FiberSemaphore::wait() {
+        SpinLock::Lock lock(guard_);
+        if (count_ > 0) {
+            --count_;
+            return;
+        }
+        waiters_.push();
+        lock.unlock();
+        FiberWaitQueue::Park();
+        // 被唤醒时信号量已经由 notify 直接交给了本协程
+    }
+
+    bool FiberSemaphore::tryWait() {
+        SpinLock::Lock lock(guard_);
+        if (count_ > 0) {
+            --count_;
+            return true;
+        }
+        return false;
+    }
+
+    void FiberSemaphore::notify() {
+        SpinLock::Lock lock(guard_);
+        if (!waiters_.notifyOne(lock)) {
+            ++count_;
+        }
+    }
+
+    void WaitGroup::add(int delta) {
+        SpinLock::Lock lock(guard_);
+        count_ += delta;
+        LUWU_ASSERT2(count_ >= 0, "negative WaitGroup counter");
+        if (count_ == 0) {
+            waiters_.notifyAll(lock);
+        }
+    }
+
+    void WaitGroup::wait() {
+        SpinLock::Lock lock(guard_);
+        if (count_ == 0) {
+            return;
+        }
+        waiters_.push();
+        lock.unlock();
+        FiberWaitQueue::Park();
+    }
+}
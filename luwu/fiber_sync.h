@@ -0,0 +1,178 @@
+//
+// Created by liucxi on 2022/12/7.
+//
+
+#ifndef LUWU_FIBER_SYNC_H
+#define LUWU_FIBER_SYNC_H
+
+#include <list>
+#include "fiber.h"
+#include "utils/mutex.h"
+#include "utils/noncopyable.h"
+
+namespace luwu {
+    class Scheduler;
+
+    /**
+     * @brief 协程等待队列，协程同步原语的公共部分
+     * @details 等待时把当前协程挂到队列上并 yield，只阻塞协程，不阻塞线程；
+     * 唤醒时通过协程原来所在的调度器的 addTask 重新调度该协程。所有操作都需要在持有外部的 guard 锁时调用，
+     * 唤醒操作会在调用 addTask 之前释放该锁，避免持有自旋锁时执行系统调用
+     */
+    class FiberWaitQueue {
+    public:
+        /**
+         * @brief 把当前协程加入等待队列
+         */
+        void push();
+
+        /**
+         * @brief 唤醒等待时间最长的协程
+         * @param lock 外部的 guard 锁，有协程被唤醒时会被释放
+         * @return 是否有协程被唤醒
+         */
+        bool notifyOne(SpinLock::Lock &lock);
+
+        /**
+         * @brief 唤醒所有等待的协程
+         * @param lock 外部的 guard 锁，返回时已经被释放
+         */
+        void notifyAll(SpinLock::Lock &lock);
+
+        bool empty() const {
+            return waiters_.empty();
+        }
+
+        /**
+         * @brief 挂起当前协程，等待被 notifyOne/notifyAll 重新调度，调用前需要已经 push 并释放 guard 锁
+         */
+        static void Park();
+
+    private:
+        /**
+         * @brief 等待者，记录协程以及唤醒时把它放回哪个调度器
+         */
+        struct Waiter {
+            Scheduler *scheduler_;
+            Fiber::ptr fiber_;
+        };
+
+        /// 等待的协程，先进先出
+        std::list<Waiter> waiters_;
+    };
+
+    /**
+     * @brief 协程互斥锁
+     * @details 加锁失败时挂起当前协程而不是线程；解锁时如果有协程在等待，锁的所有权直接交给等待最久的协程
+     */
+    class FiberMutex : NonCopyable {
+    public:
+        using Lock = ScopedLockImpl<FiberMutex>;
+
+        void lock();
+
+        bool tryLock();
+
+        void unlock();
+
+    private:
+        SpinLock guard_;
+        /// 是否已经被锁住
+        bool locked_ = false;
+        /// 等待加锁的协程
+        FiberWaitQueue waiters_;
+    };
+
+    /**
+     * @brief 协程条件变量，配合 FiberMutex 使用
+     */
+    class FiberCondVar : NonCopyable {
+    public:
+        /**
+         * @brief 释放 mutex 并挂起当前协程，被唤醒后重新加锁再返回
+         * @param mutex 调用者已经持有的协程互斥锁
+         */
+        void wait(FiberMutex &mutex);
+
+        void notifyOne();
+
+        void notifyAll();
+
+    private:
+        SpinLock guard_;
+        /// 等待条件的协程
+        FiberWaitQueue waiters_;
+    };
+
+    /**
+     * @brief 协程信号量
+     */
+    class FiberSemaphore : NonCopyable {
+    public:
+        explicit FiberSemaphore(uint32_t count = 0) : count_(count) {}
+
+        /**
+         * @brief 获取一个信号量，没有可用的信号量时挂起当前协程
+         */
+        void wait();
+
+        /**
+         * @brief 尝试获取一个信号量，不挂起
+         * @return 是否获取成功
+         */
+        bool tryWait();
+
+        /**
+         * @brief 释放一个信号量，有协程在等待时直接交给等待最久的协程
+         */
+        void notify();
+
+    private:
+        SpinLock guard_;
+        /// 可用的信号量数量
+        uint32_t count_;
+        /// 等待信号量的协程
+        FiberWaitQueue waiters_;
+    };
+
+    /**
+     * @brief 等待一组协程结束，类似 Go 的 sync.WaitGroup
+     * @details 派发子任务之前 add，子任务结束时 done，wait 挂起当前协程直到计数归零
+     */
+    class WaitGroup : NonCopyable {
+    public:
+        explicit WaitGroup(int count = 0) : count_(count) {}
+
+        /**
+         * @brief 增加（或减少）计数，计数归零时唤醒所有等待的协程
+         * @param delta 变化量
+         */
+        void add(int delta = 1);
+
+        /**
+         * @brief 计数减一
+         */
+        void done() {
+            add(-1);
+        }
+
+        /**
+         * @brief 挂起当前协程直到计数归零
+         */
+        void wait();
+
+        int getCount() {
+            SpinLock::Lock lock(guard_);
+            return count_;
+        }
+
+    private:
+        SpinLock guard_;
+        /// 尚未结束的子任务数量
+        int count_;
+        /// 等待计数归零的协程
+        FiberWaitQueue waiters_;
+    };
+}
+
+#endif //LUWU_FIBER_SYNC_H
@@ -9,6 +9,7 @@
 #include <cstdarg>
 #include "fiber.h"
 #include "reactor.h"
+#include "cancel_token.h"
 #include "file_descriptor.h"
 
 // 带参数的宏定义
@@ -61,6 +62,84 @@ namespace luwu {
         int canceled = 0;
     };
 
+    /**
+     * @brief 挂起当前协程，直到 fd 上的事件到来、超时或者协程绑定的取消令牌被取消
+     * @param fd socket 文件描述符
+     * @param event 等待的事件
+     * @param timeout socket 上设置的超时时间，0 表示不超时
+     * @param token 当前协程绑定的取消令牌，可以为空
+     * @return 0 表示事件到来（或者添加事件失败，调用者需要再试一次），否则为错误码 ETIMEDOUT/ECANCELED
+     */
+    static int wait_event(int fd, uint32_t event, uint64_t timeout, const CancelToken::ptr &token) {
+        // 令牌的截止时间与 socket 的超时时间取较小值，到期同样返回 ETIMEDOUT
+        if (token) {
+            uint64_t remaining = token->getRemaining();
+            if (remaining == 0) {
+                return ETIMEDOUT;
+            }
+            if (remaining != UINT64_MAX && (timeout == 0 || remaining < timeout)) {
+                timeout = remaining;
+            }
+        }
+
+        auto r = Reactor::GetThis();
+        std::shared_ptr<ClockInfo> shared_info(new ClockInfo);
+        std::weak_ptr<ClockInfo> weak_info(shared_info);        // 指向 shared_info 但不增加引用计数
+
+        Clock::ptr clock;
+        // 如果设置了超时时间
+        if (timeout != 0) {
+            clock = r->addCondClock(timeout, [r, weak_info, fd, event](){
+                auto t = weak_info.lock();
+                if (t) {
+                    t->canceled = ETIMEDOUT;        // 设置超时标志
+                }
+                // 删除前触发一次，使添加该定时器的协程可以 resume
+                r->delEvent(fd, static_cast<ReactorEvent::Event>(event), true);
+            }, weak_info);
+        }
+
+        bool rt = r->addEvent(fd, static_cast<ReactorEvent::Event>(event));
+        if (rt) {
+            uint64_t cancel_id = 0;
+            if (token && !token->addCallback([r, weak_info, fd, event](int error){
+                    auto t = weak_info.lock();
+                    if (!t) {
+                        return;                     // 等待已经结束
+                    }
+                    t->canceled = error;
+                    r->delEvent(fd, static_cast<ReactorEvent::Event>(event), true);
+                }, cancel_id)) {
+                // 令牌在添加事件之前已经被取消，撤销事件直接返回
+                r->delEvent(fd, static_cast<ReactorEvent::Event>(event));
+                if (clock) {
+                    clock->cancel();
+                }
+                return token->getError();
+            }
+
+            Fiber::GetThis()->yield();
+            // resume 有三种可能：定时器超时，令牌被取消，注册的事件到来
+            if (token) {
+                token->delCallback(cancel_id);
+            }
+            if (clock) {
+                clock->cancel();
+            }
+            // 1. 超时或者被取消，返回错误
+            if (shared_info->canceled) {
+                return shared_info->canceled;
+            }
+            // 2. 由于事件发生返回的，调用者再次执行系统调用
+        } else {
+            // 添加事件出错，调用者再次执行系统调用
+            if (clock) {
+                clock->cancel();
+            }
+        }
+        return 0;
+    }
+
     /**
      * @brief io 类型的系统调用的统一处理模板类
      * @tparam OriginFunc 原始系统调用
@@ -87,6 +166,16 @@ namespace luwu {
             return func(fd, std::forward<Args>(args)...);
         }
 
+        // 协程绑定的令牌已经被取消或者已经过了截止时间，直接返回
+        auto token = CancelToken::GetCurrent();
+        if (token) {
+            int error = token->getError();
+            if (error) {
+                errno = error;
+                return -1;
+            }
+        }
+
         // 执行到这里是 -- 用户没有设置非阻塞的 socket 文件描述符
         // 获得 socket 文件描述符的超时事件，没有设置结果为 0
         timeval tv{};
@@ -103,41 +192,10 @@ namespace luwu {
 
             // 立即返回了，但是没有新连接到来或者没有数据可读写
             if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-                auto r = Reactor::GetThis();
-                std::shared_ptr<ClockInfo> shared_info(new ClockInfo);
-                std::weak_ptr<ClockInfo> weak_info(shared_info);        // 指向 shared_info 但不增加引用计数
-
-                Clock::ptr clock;
-                // 如果设置了超时时间
-                if (timeout != 0) {
-                    clock = r->addCondClock(timeout, [r, weak_info, fd, event](){
-                        auto t = weak_info.lock();
-                        if (t) {
-                            t->canceled = ETIMEDOUT;        // 设置超时标志
-                        }
-                        // 删除前触发一次，使添加该定时器的协程可以 resume
-                        r->delEvent(fd, static_cast<ReactorEvent::Event>(event), true);
-                    }, weak_info);
-                }
-
-                bool rt = r->addEvent(fd, static_cast<ReactorEvent::Event>(event));
-                if (rt) {
-                    Fiber::GetThis()->yield();
-                    // resume 有两种可能：定时器超时，注册的事件到来
-                    // 1. 用户没有设置非阻塞，有超时时间，所以在超时之后返回错误
-                    if (shared_info->canceled) {
-                        errno = shared_info->canceled;
-                        return -1;
-                    }
-                    // 2. 没有超时，是由于事件发生返回的，所以取消定时器，再次接受数据
-                    if (clock) {
-                        clock->cancel();
-                    }
-                } else {
-                    // 添加事件出错，再次接受数据
-                    if (clock) {
-                        clock->cancel();
-                    }
+                int error = wait_event(fd, event, timeout, token);
+                if (error) {
+                    errno = error;
+                    return -1;
                 }
             } else {
                 break;
@@ -197,6 +255,15 @@ extern "C" {
             return connect_f(sockfd, addr, addlen);
         }
 
+        auto token = luwu::CancelToken::GetCurrent();
+        if (token) {
+            int error = token->getError();
+            if (error) {
+                errno = error;
+                return -1;
+            }
+        }
+
         // 执行到这里是 -- 用户没有设置非阻塞的 socket 文件描述符
         // 获得 socket 文件描述符的超时事件，没有设置结果为 0
         timeval tv{};
@@ -213,42 +280,11 @@ extern "C" {
         }
 
         // 立即返回了，但是没有连接成功
-        // n == -1 && errno == EINPROGRESS，表示连接还在进行中
-        auto r = luwu::Reactor::GetThis();
-        std::shared_ptr<luwu::ClockInfo> shared_info(new luwu::ClockInfo);
-        std::weak_ptr<luwu::ClockInfo> weak_info(shared_info);              // 指向 shared_info 但不增加引用计数
-
-        luwu::Clock::ptr clock;
-        if (timeout != 0) {
-            clock = r->addCondClock(timeout, [r, weak_info, sockfd](){
-                auto t = weak_info.lock();
-                if (t) {
-                    t->canceled = ETIMEDOUT;
-                }
-                // 删除前触发一次，使添加该定时器的协程可以 resume
-                r->delEvent(sockfd, luwu::ReactorEvent::WRITE, true);
-            }, weak_info);
-        }
-
-
-        bool rt = r->addEvent(sockfd, luwu::ReactorEvent::WRITE);
-        if (rt) {
-            luwu::Fiber::GetThis()->yield();
-            // resume 有两种可能：定时器超时，写事件到来
-            // 1. 超时之后返回错误
-            if (shared_info->canceled) {
-                errno = shared_info->canceled;
-                return -1;
-            }
-            // 2. 没有超时，是由于事件发生返回的，所以取消定时器
-            if (clock) {
-                clock->cancel();
-            }
-        } else {
-            // 添加写事件出错
-            if (clock) {
-                clock->cancel();
-            }
+        // n == -1 && errno == EINPROGRESS，表示连接还在进行中，等待写事件、超时或者被取消
+        int wait_error = luwu::wait_event(sockfd, luwu::ReactorEvent::WRITE, timeout, token);
+        if (wait_error) {
+            errno = wait_error;
+            return -1;
         }
 
         // 执行到这里是 -- connect 连接成功或者添加写事件失败
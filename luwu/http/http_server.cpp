@@ -5,6 +5,7 @@
 #include <iostream>
 #include "http_server.h"
 #include "../logger.h"
+#include "../cancel_token.h"
 
 namespace luwu {
     namespace http {
@@ -28,12 +29,16 @@ namespace luwu {
                 }
                 bool close = req->isClose() || !keepalive_;
                 HttpResponse::ptr rsp(new HttpResponse(req->getVersion(), close));
-                int rt = dispatch_->handle(req, rsp, conn);
-                if (rt == -1) {
-                    LUWU_LOG_ERROR(LUWU_LOG_ROOT()) << "http handle client return -1! request path = " << req->getPath();
-                    break;
+                {
+                    // 处理时限只覆盖处理和发送响应，不包括长连接上等待下一个请求的时间
+                    CancelToken::Guard guard(request_timeout_ ? CancelToken::Create(request_timeout_) : nullptr);
+                    int rt = dispatch_->handle(req, rsp, conn);
+                    if (rt == -1) {
+                        LUWU_LOG_ERROR(LUWU_LOG_ROOT()) << "http handle client return -1! request path = " << req->getPath();
+                        break;
+                    }
+                    conn->sendResponse(rsp);
                 }
-                conn->sendResponse(rsp);
                 if (close) {
                     LUWU_LOG_INFO(LUWU_LOG_ROOT()) << "http handle client over, client address = "
                                                    << client->getPeerAddress()->toString();
@@ -34,6 +34,15 @@ namespace luwu {
              */
             ServletDispatch::ptr getDispatch() { return dispatch_; }
 
+            /**
+             * @brief 设置单个请求的处理时限
+             * @param timeout 从收到请求到发送完响应的最长时间，单位毫秒，0 表示不限制
+             * @details 超时之后处理协程中被 hook 的 IO（包括 servlet 发起的后端调用）返回 ETIMEDOUT，过载时可以尽快丢弃慢请求
+             */
+            void setRequestTimeout(uint64_t timeout) { request_timeout_ = timeout; }
+
+            uint64_t getRequestTimeout() const { return request_timeout_; }
+
         protected:
             /**
              * @brief http 服务器的 handle client
@@ -46,6 +55,8 @@ namespace luwu {
             bool keepalive_;
             /// servlet 分发器
             ServletDispatch::ptr dispatch_;
+            /// 单个请求的处理时限，单位毫秒，0 表示不限制
+            uint64_t request_timeout_ = 0;
         };
     }
 }
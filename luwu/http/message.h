@@ -5,6 +5,7 @@
 #ifndef LUWU_MESSAGE_H
 #define LUWU_MESSAGE_H
 
+#include <string>
 #include <memory>
 #include <vector>
 #include <unordered_map>
@@ -3,6 +3,7 @@
 //
 
 #include "servlet.h"
+#include "fiber.h"
 #include <fnmatch.h>
 #include <utility>
 #include <iostream>
@@ -356,6 +357,31 @@ namespace luwu {
             return 0;
         }
 
+        /**
+         * @brief 处理请求期间把当前协程命名为 servlet 的名称，处理结束后恢复原来的名称
+         * @details 处理函数长时间不让出时调度器的看门狗据此报告是哪个 servlet，监控线程的即时报告只能看到时间片开始时的名称，
+         * 要等处理函数让出过一次。长连接上同一个协程接着等待和解析下一个请求，不能把这段时间算到上一个 servlet 头上。
+         * 不在协程中调用时没有可以记录的地方
+         */
+        struct FiberNameGuard {
+            explicit FiberNameGuard(const std::string &name)
+                : fiber_(Fiber::GetFiberId() != static_cast<uint32_t>(-1) ? Fiber::GetThis().get() : nullptr) {
+                if (fiber_) {
+                    name_ = fiber_->getName();
+                    fiber_->setName(name);
+                }
+            }
+
+            ~FiberNameGuard() {
+                if (fiber_) {
+                    fiber_->setName(name_);
+                }
+            }
+
+            Fiber *fiber_;
+            std::string name_;
+        };
+
         ServletDispatch::ServletDispatch(std::string name)
             : name_(std::move(name)), default_(new ServletNotFound){
         }
@@ -363,6 +389,7 @@ namespace luwu {
         int ServletDispatch::handle(HttpRequest::ptr req, HttpResponse::ptr rsp, HttpConnection::ptr session) {
             auto servlet = getMatchedServlet(req->getPath());
             if (servlet) {
+                FiberNameGuard guard(servlet->getName());
                 return std::dynamic_pointer_cast<HttpServlet>(servlet)->handle(req, rsp, session);
             } else {
                 return getDefaultServlet()->handle(req, rsp, session);
@@ -372,6 +399,7 @@ namespace luwu {
         int ServletDispatch::handle(HttpRequest::ptr req, WSFrameMessage::ptr rsp, WSConnection::ptr session) {
             auto servlet = getMatchedServlet(req->getPath());
             if (servlet) {
+                FiberNameGuard guard(servlet->getName());
                 return std::dynamic_pointer_cast<WSServlet>(servlet)->handle(req, rsp, session);
             }
             return -1;
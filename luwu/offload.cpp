@@ -0,0 +1,67 @@
+//
+// Created by liucxi on 2022/12/18.
+//
+
+#include "offload.h"
+#include <thread>
+#include <algorithm>
+
+namespace luwu {
+
+    // region # OffloadPool::OffloadPool()
+    OffloadPool::OffloadPool(std::string name, uint32_t thread_num, uint32_t max_pending)
+        : name_(std::move(name)), slots_(std::max<uint32_t>(max_pending, 1)), stopping_(false) {
+        if (thread_num == 0) {
+            // 线程大部分时间阻塞在系统调用里，数量不必受 CPU 数量限制
+            thread_num = std::max(std::thread::hardware_concurrency(), 4u);
+        }
+        for (uint32_t i = 0; i < thread_num; ++i) {
+            threads_.emplace_back(new Thread(name_ + "_" + std::to_string(i), std::bind(&OffloadPool::work, this)));
+        }
+    }
+    // endregion
+
+    OffloadPool::~OffloadPool() {
+        {
+            Mutex::Lock lock(mutex_);
+            stopping_ = true;
+        }
+        for (size_t i = 0; i < threads_.size(); ++i) {
+            pending_.notify();
+        }
+        for (auto &thread : threads_) {
+            thread->join();
+        }
+    }
+
+    void OffloadPool::enqueue(task_func job) {
+        slots_.wait();
+        {
+            Mutex::Lock lock(mutex_);
+            jobs_.push_back(std::move(job));
+        }
+        pending_.notify();
+    }
+
+    void OffloadPool::work() {
+        while (true) {
+            pending_.wait();
+            task_func job;
+            {
+                Mutex::Lock lock(mutex_);
+                // 停止时先执行完已经排队的任务，等待它们的协程才能被唤醒
+                if (jobs_.empty()) {
+                    if (stopping_) {
+                        break;
+                    }
+                    continue;
+                }
+                job = std::move(jobs_.front());
+                jobs_.pop_front();
+            }
+            slots_.notify();
+            // 设置结果时把等待的协程放回它原来的调度器
+            job();
+        }
+    }
+}
@@ -0,0 +1,156 @@
+//
+// Created by liucxi on 2022/12/18.
+//
+
+#ifndef LUWU_OFFLOAD_H
+#define LUWU_OFFLOAD_H
+
+#include <deque>
+#include <string>
+#include <vector>
+#include "thread.h"
+#include "scheduler.h"
+#include "fiber_sync.h"
+#include "fiber_future.h"
+#include "utils/mutex.h"
+#include "utils/asserts.h"
+#include "utils/singleton.h"
+#include "utils/noncopyable.h"
+#include "utils/inplace_function.h"
+
+namespace luwu {
+    /**
+     * @brief 阻塞任务卸载线程池
+     * @details 普通文件 IO、getaddrinfo、耗时的加解密等无法 hook 的阻塞调用放到这里的独立线程上执行，
+     * 调用它的协程挂起，结果就绪后回到原来的调度器继续执行，调度线程（尤其是反应堆线程）始终只处理网络 IO。
+     * 线程数量固定，排队的任务数量有上限，队列满时提交任务的协程挂起等待，而不是无限堆积
+     */
+    class OffloadPool : NonCopyable {
+    public:
+        using ptr = std::shared_ptr<OffloadPool>;
+
+        /**
+         * @brief 构造函数，创建并启动所有线程
+         * @param name 线程池名称
+         * @param thread_num 线程数量，为 0 时使用 CPU 数量，至少为 4
+         * @param max_pending 最多排队的任务数量
+         */
+        explicit OffloadPool(std::string name = "offload", uint32_t thread_num = 0, uint32_t max_pending = 1024);
+
+        /**
+         * @brief 析构函数，执行完已经排队的任务之后退出所有线程
+         */
+        ~OffloadPool();
+
+        /**
+         * @brief 提交一个阻塞任务，不等待结果
+         * @param fn 任务，签名为 R()，R 需要可默认构造
+         * @return 任务结果，在协程中 get 时挂起该协程，结果就绪后回到协程原来的调度器
+         * @details 必须在调度器的任务协程中调用，否则断言失败；队列已满时挂起当前协程直到有空位
+         */
+        template<typename Func>
+        auto submit(Func fn) -> Future<decltype(fn())> {
+            // 队列满时要挂起当前协程，入口处检查，不要等到负载高时才失败
+            LUWU_ASSERT2(Scheduler::InTaskFiber(), "OffloadPool::submit must be called in a fiber run by a scheduler");
+            using Result = decltype(fn());
+            Promise<Result> promise;
+            Future<Result> future = promise.getFuture();
+            enqueue(Job<Func, Result>(std::move(fn), std::move(promise)));
+            return future;
+        }
+
+        /**
+         * @brief 在线程池中执行阻塞任务，挂起当前协程直到执行结束
+         * @param fn 任务，签名为 R()，R 需要可默认构造
+         * @return 任务的返回值
+         * @details 不在调度器的任务协程中调用时（包括直接在调度协程上执行的任务）不能挂起，直接在当前线程执行，
+         * 当前线程本来就可以阻塞
+         */
+        template<typename Func>
+        auto run(Func fn) -> decltype(fn()) {
+            if (!Scheduler::InTaskFiber()) {
+                return fn();
+            }
+            return submit(std::move(fn)).get();
+        }
+
+        // region # Getter and Setter
+        const std::string &getName() const {
+            return name_;
+        }
+
+        uint32_t getThreadNum() const {
+            return static_cast<uint32_t>(threads_.size());
+        }
+        // endregion
+
+    private:
+        /**
+         * @brief 线程池中的任务，执行函数并设置结果
+         */
+        template<typename Func, typename Result>
+        struct Job {
+            Job(Func fn, Promise<Result> promise) : fn_(std::move(fn)), promise_(std::move(promise)) {}
+
+            void operator()() {
+                promise_.setValue(fn_());
+            }
+
+            Func fn_;
+            Promise<Result> promise_;
+        };
+
+        template<typename Func>
+        struct Job<Func, void> {
+            Job(Func fn, Promise<void> promise) : fn_(std::move(fn)), promise_(std::move(promise)) {}
+
+            void operator()() {
+                fn_();
+                promise_.setValue();
+            }
+
+            Func fn_;
+            Promise<void> promise_;
+        };
+
+        /**
+         * @brief 任务放入队列，队列已满时挂起当前协程
+         * @param job 任务
+         */
+        void enqueue(task_func job);
+
+        /**
+         * @brief 线程池中线程的入口函数
+         */
+        void work();
+
+    private:
+        /// 线程池名称
+        std::string name_;
+        Mutex mutex_;
+        /// 排队的任务
+        std::deque<task_func> jobs_;
+        /// 排队任务的数量，线程在上面等待
+        Semaphore pending_;
+        /// 队列中的空位，提交任务的协程在上面等待
+        FiberSemaphore slots_;
+        /// 是否正在停止
+        bool stopping_;
+        /// 线程
+        std::vector<Thread::ptr> threads_;
+    };
+
+    using OffloadPoolMgr = Singleton<OffloadPool>;
+
+    /**
+     * @brief 在默认的卸载线程池中执行阻塞任务，挂起当前协程直到执行结束，见 OffloadPool::run
+     * @param fn 任务，签名为 R()
+     * @return 任务的返回值
+     */
+    template<typename Func>
+    auto offload(Func fn) -> decltype(fn()) {
+        return OffloadPoolMgr::GetInstance().run(std::move(fn));
+    }
+}
+
+#endif //LUWU_OFFLOAD_H
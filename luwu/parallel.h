@@ -0,0 +1,99 @@
+//
+// Created by liucxi on 2022/12/9.
+//
+
+#ifndef LUWU_PARALLEL_H
+#define LUWU_PARALLEL_H
+
+#include <memory>
+#include <vector>
+#include <iterator>
+#include <functional>
+#include "fiber_sync.h"
+#include "scheduler.h"
+
+namespace luwu {
+    /**
+     * @brief 把 [begin, end) 按 grain 切分成若干块，分发到当前调度器的所有线程上并行执行
+     * @param begin 起始下标
+     * @param end 结束下标（不包含）
+     * @param grain 每块的大小，至少为 1
+     * @param func 处理一块的函数，签名为 void(Index chunk_begin, Index chunk_end)
+     * @details 当前协程执行最后一块，然后挂起等待其余块完成，不阻塞线程；不在调度器的任务协程中调用时退化为串行执行。
+     * 任务状态分配在堆上，调用者是共享栈协程时也是安全的，但 func 自身捕获的引用需要调用者保证有效
+     */
+    template<typename Index, typename Func>
+    void parallelFor(Index begin, Index end, Index grain, Func func) {
+        if (begin >= end) {
+            return;
+        }
+        if (grain < 1) {
+            grain = 1;
+        }
+        // 不在调度器调度的任务协程中（包括 use_caller 调度器所在线程的 main 函数、直接在调度协程上执行的任务）时无法挂起等待，
+        // 串行执行
+        if (!Scheduler::InTaskFiber() || end - begin <= grain) {
+            func(begin, end);
+            return;
+        }
+        Scheduler *scheduler = Scheduler::GetThis();
+
+        struct ForState {
+            explicit ForState(Func f) : func_(std::move(f)) {}
+
+            Func func_;
+            WaitGroup wg_;
+        };
+        auto state = std::make_shared<ForState>(std::move(func));
+
+        // 所有块一次性加入调度器，只通知需要的空闲线程
+        std::vector<Fiber::fiber_func> chunks;
+        Index chunk_begin = begin;
+        for (; end - chunk_begin > grain; chunk_begin += grain) {
+            Index chunk_end = chunk_begin + grain;
+            chunks.emplace_back([state, chunk_begin, chunk_end]() {
+                state->func_(chunk_begin, chunk_end);
+                state->wg_.done();
+            });
+        }
+        state->wg_.add(static_cast<int>(chunks.size()));
+        scheduler->addTasks(chunks.begin(), chunks.end());
+        state->func_(chunk_begin, end);
+        state->wg_.wait();
+    }
+
+    /**
+     * @brief 并行归约，把 [begin, end) 按 grain 切分后分别计算，再按块的顺序合并结果
+     * @param begin 起始下标
+     * @param end 结束下标（不包含）
+     * @param grain 每块的大小，至少为 1
+     * @param identity 初始值
+     * @param map 计算一块的函数，签名为 T(Index chunk_begin, Index chunk_end)
+     * @param reduce 合并两个结果的函数，签名为 T(T, T)
+     * @return 归约结果
+     * @details 合并按块的顺序串行进行，reduce 只需要满足结合律，不要求交换律
+     */
+    template<typename T, typename Index, typename Map, typename Reduce>
+    T parallelReduce(Index begin, Index end, Index grain, T identity, Map map, Reduce reduce) {
+        if (begin >= end) {
+            return identity;
+        }
+        if (grain < 1) {
+            grain = 1;
+        }
+        size_t chunks = static_cast<size_t>((end - begin + grain - 1) / grain);
+        auto results = std::make_shared<std::vector<T>>(chunks, identity);
+
+        parallelFor(begin, end, grain, [results, begin, grain, map](Index chunk_begin, Index chunk_end) {
+            (*results)[static_cast<size_t>((chunk_begin - begin) / grain)] = map(chunk_begin, chunk_end);
+        });
+
+        T result = std::move(identity);
+        for (auto &item : *results) {
+            result = reduce(std::move(result), std::move(item));
+        }
+        return result;
+    }
+}
+
+#endif //LUWU_PARALLEL_H
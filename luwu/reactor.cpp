@@ -4,6 +4,7 @@
 
 #include "reactor.h"
 
+#include <algorithm>
 #include <utility>
 #include <unistd.h>
 #include <cstring>
@@ -12,8 +13,11 @@
 #include <iostream>
 #include "logger.h"
 #include "utils/asserts.h"
+#include "utils/util.h"
 
 namespace luwu {
+    // 本线程最近几次进入空闲到有任务到达的平均间隔，单位微秒，0 表示还没有统计
+    static thread_local uint64_t t_arrival_interval = 0;
 
     Channel::Channel(int fd, ReactorEvent::Event event) : fd_(fd), event_(event) {}
 
@@ -32,18 +36,27 @@ namespace luwu {
         event_callback.scheduler_ = nullptr;
         event_callback.fiber_.reset();
         event_callback.func_ = nullptr;
+        event_callback.inline_ = false;
     }
 
     void Channel::triggerEvent(ReactorEvent::Event event) {
-        LUWU_ASSERT(event_ & event);
-        event_ = static_cast<ReactorEvent::Event>(event_ & ~event);
-        EventCallback &callback = getEventCallback(event);
+        EventCallback callback = takeEvent(event);
         if (callback.fiber_) {
-            callback.scheduler_->addTask(callback.fiber_);
+            callback.scheduler_->addTask(std::move(callback.fiber_));
+        } else if (callback.inline_) {
+            callback.scheduler_->addInlineTask(std::move(callback.func_));
         } else {
-            callback.scheduler_->addTask(callback.func_);
+            callback.scheduler_->addTask(std::move(callback.func_));
         }
+    }
+
+    Channel::EventCallback Channel::takeEvent(ReactorEvent::Event event) {
+        LUWU_ASSERT(event_ & event);
+        event_ = static_cast<ReactorEvent::Event>(event_ & ~event);
+        EventCallback &callback = getEventCallback(event);
+        EventCallback taken = std::move(callback);
         resetEventCallback(callback);
+        return taken;
     }
 
     // region # Reactor::Reactor()
@@ -51,22 +64,48 @@ namespace luwu {
             : Scheduler(std::move(name), thread_num, use_caller)
             , epoll_fd_(::epoll_create1(EPOLL_CLOEXEC))
             , wakeup_fd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
-            , pending_event_num_(0) {
+            , pending_event_num_(0)
+            , spin_time_(0)
+            , spinning_num_(0)
+            , timers_fired_(0)
+            , tickles_(0)
+            , skipped_tickles_(0) {
+        init();
+        // 启动调度器
+        start();
+    }
+
+    Reactor::Reactor(std::string name, uint32_t min_thread_num, uint32_t max_thread_num, bool use_caller,
+                     uint64_t max_queue_delay, uint64_t idle_timeout)
+            : Scheduler(std::move(name), min_thread_num, use_caller)
+            , epoll_fd_(::epoll_create1(EPOLL_CLOEXEC))
+            , wakeup_fd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+            , pending_event_num_(0)
+            , spin_time_(0)
+            , spinning_num_(0)
+            , timers_fired_(0)
+            , tickles_(0)
+            , skipped_tickles_(0) {
+        init();
+        setElastic(min_thread_num, max_thread_num, max_queue_delay, idle_timeout);
+        start();
+    }
+    // endregion
 
+    void Reactor::init() {
         LUWU_ASSERT(epoll_fd_ != -1);
         LUWU_ASSERT(wakeup_fd_ != -1);
 
-        // 统一事件源，将 wakeup_fd 也加入 epoll 进行管理
-        addEvent(wakeup_fd_, ReactorEvent::READ, [&]() {
-            eventfd_t et;
-            eventfd_read(wakeup_fd_, &et);
-        });
+        // 统一事件源，将 wakeup_fd 也加入 epoll 进行管理。它需要一直被监听，不能像普通事件那样触发一次就删除，
+        // 所以不经过 addEvent 注册，data.ptr 为空表示唤醒事件，在 idle 中直接读出计数值
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.ptr = nullptr;
+        int rt = epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wakeup_fd_, &ev);
+        LUWU_ASSERT(rt == 0);
 
         channelResize(32);
-        // 启动调度器
-        start();
     }
-    // endregion
 
     void Reactor::channelResize(size_t size) {
         channels_.resize(size);
@@ -87,7 +126,7 @@ namespace luwu {
         }
     }
 
-    bool Reactor::addEvent(int fd, ReactorEvent::Event event, const std::function<void()> &cb) {
+    bool Reactor::addEvent(int fd, ReactorEvent::Event event, Fiber::fiber_func cb, bool inline_task) {
         // 取出 fd 对应的 channel，如果没有则扩容
         Channel *channel;
         RWMutex::ReadLock lock(mutex_);
@@ -128,11 +167,13 @@ namespace luwu {
 
         event_callback.scheduler_ = Scheduler::GetThis();
         if (cb) {
-            event_callback.func_ = cb;
+            event_callback.func_ = std::move(cb);
+            event_callback.inline_ = inline_task;
         } else {
             // 回调函数为空，说明是一个回调函数中途 yield，将自己添加到 epoll 中，等待再次执行，所以把当前协程当作回调
             event_callback.fiber_ = Fiber::GetThis()->shared_from_this();
-            LUWU_ASSERT(event_callback.fiber_->getState() == Fiber::RUNNING);
+            Fiber::State state = event_callback.fiber_->getState();
+            LUWU_ASSERT(state == Fiber::RUNNING || state == Fiber::NOTIFIED);
         }
         return true;
     }
@@ -177,47 +218,129 @@ namespace luwu {
         return true;
     }
 
+    void Reactor::collectEvent(Channel *channel, ReactorEvent::Event event, std::vector<SchedulerTask> &tasks) {
+        Scheduler *scheduler = channel->getEventCallback(event).scheduler_;
+        if (scheduler && scheduler != this) {
+            channel->triggerEvent(event);
+            return;
+        }
+        Channel::EventCallback callback = channel->takeEvent(event);
+        if (callback.fiber_) {
+            tasks.emplace_back(std::move(callback.fiber_));
+        } else {
+            tasks.emplace_back(std::move(callback.func_));
+            tasks.back().inline_ = callback.inline_;
+            if (callback.inline_) {
+                tasks.back().priority_ = CRITICAL;
+            }
+        }
+    }
+
     Reactor *Reactor::GetThis() {
         return dynamic_cast<Reactor *>(Scheduler::GetThis());
     }
 
+    Reactor::Metrics Reactor::getReactorMetrics() const {
+        Metrics metrics;
+        static_cast<Scheduler::Metrics &>(metrics) = Scheduler::getMetrics();
+        metrics.events_per_wakeup_ = events_per_wakeup_.snapshot();
+        metrics.timers_fired_ = timers_fired_.load(std::memory_order_relaxed);
+        metrics.tickles_ = tickles_.load(std::memory_order_relaxed);
+        metrics.skipped_tickles_ = skipped_tickles_.load(std::memory_order_relaxed);
+        metrics.pending_events_ = pending_event_num_.load(std::memory_order_relaxed);
+        return metrics;
+    }
+
     bool Reactor::stopping() {
         uint64_t timeout = getNextTime();
         // 定时器和调度器都没有任务时才可以停止
         return timeout == ~0ull && pending_event_num_ == 0 && Scheduler::stopping();
     }
 
+    int Reactor::spin(epoll_event *events, int max_events) {
+        // 最近任务到达的间隔比自旋时间长，自旋大概率白白浪费 CPU；否则自旋到平均间隔的两倍为止
+        uint64_t budget = spin_time_;
+        if (t_arrival_interval) {
+            budget = t_arrival_interval > spin_time_ ? 0 : std::min(spin_time_, t_arrival_interval * 2);
+        }
+        if (budget == 0) {
+            return 0;
+        }
+        int event_num = 0;
+        ++spinning_num_;
+        uint64_t deadline = getElapseUs() + budget;
+        do {
+            event_num = epoll_wait(epoll_fd_, events, max_events, 0);
+            if (event_num > 0 || hasReadyTask() || getNextTime() == 0) {
+                break;
+            }
+        } while (getElapseUs() < deadline);
+        --spinning_num_;
+        // 与 tickle 中的栅栏配对：之后 idle 再检查任务队列时一定能看到跳过唤醒的那些任务
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return std::max(event_num, 0);
+    }
+
     void Reactor::idle() {
         static const uint32_t MAX_EVENTS = 256;
         static const uint64_t MAX_TIMEOUT = 3000;
         std::vector<epoll_event> events(MAX_EVENTS);
 
-        while (!stopping()) {
-            // 根据定时器确定超时时间
-            uint64_t next_timeout = getNextTime();
-            if (next_timeout != ~0ull) {
-                next_timeout = std::min(next_timeout, MAX_TIMEOUT);
-            } else {
-                next_timeout = MAX_TIMEOUT;
-            }
+        while (!stopping() && !retiring()) {
+            uint64_t idle_begin = getElapseUs();
+            // 先自旋等待一小段时间，任务很快到达时不需要睡眠和唤醒
+            int event_num = spin_time_ ? spin(&*events.begin(), MAX_EVENTS) : 0;
+            bool blocked = false;
+
+            // 自旋结束之后再检查一次任务队列，与 tickle 中对自旋线程数量的检查配对，避免错过通知
+            if (event_num == 0 && !hasReadyTask() && !stopping()) {
+                // 根据定时器确定超时时间
+                uint64_t next_timeout = getNextTime();
+                if (next_timeout != ~0ull) {
+                    next_timeout = std::min(next_timeout, MAX_TIMEOUT);
+                } else {
+                    next_timeout = MAX_TIMEOUT;
+                }
 
-            // 阻塞等待
-            int event_num = epoll_wait(epoll_fd_, &*events.begin(), MAX_EVENTS,
+                // 阻塞等待
+                event_num = epoll_wait(epoll_fd_, &*events.begin(), MAX_EVENTS,
                                        static_cast<int>(next_timeout));
+                blocked = true;
+            }
+            // 自旋期间得到事件，或者从阻塞等待中返回（包括超时），都算一次唤醒
+            if (event_num > 0 || (blocked && event_num == 0)) {
+                events_per_wakeup_.record(static_cast<uint64_t>(event_num));
+            }
+            if (spin_time_) {
+                uint64_t interval = getElapseUs() - idle_begin;
+                t_arrival_interval = t_arrival_interval ? (t_arrival_interval * 7 + interval) / 8 : interval;
+            }
 
             // TODO 处理信号
             // 退出 epoll_wait 说明有定时器超时或者有事件发生
 
-            // 处理超时的定时器
-            std::vector<std::function<void()>> callbacks;
+            // 处理超时的定时器，和到来的事件一起收集起来，最后批量加入调度器，只通知需要的空闲线程
+            std::vector<Clock::clock_callback> callbacks;
             listExpiredCallback(callbacks);
-            for (const auto &callback: callbacks) {
-                addTask(callback);
+            if (!callbacks.empty()) {
+                timers_fired_.fetch_add(callbacks.size(), std::memory_order_relaxed);
+            }
+            std::vector<SchedulerTask> tasks;
+            tasks.reserve(callbacks.size() + std::max(event_num, 0));
+            for (auto &callback: callbacks) {
+                tasks.emplace_back(std::move(callback));
+                tasks.back().priority_ = CRITICAL;          // 定时器回调都很短，不应该排在大批普通任务后面
             }
 
-            // 处理到来的事件
+            // 处理到来的事件，任务入队之后才减少等待事件数量，避免其他线程在这期间误判可以停止
+            uint32_t triggered = 0;
             for (int i = 0; i < event_num; ++i) {
                 epoll_event &event = events[i];
+                if (!event.data.ptr) {
+                    eventfd_t et;
+                    eventfd_read(wakeup_fd_, &et);
+                    continue;
+                }
                 auto *channel = static_cast<Channel *>(event.data.ptr);
                 Mutex::Lock lock(channel->mutex_);
 
@@ -243,14 +366,16 @@ namespace luwu {
                 }
 
                 if (real_events & EPOLLIN) {
-                    channel->triggerEvent(ReactorEvent::READ);
-                    --pending_event_num_;
+                    collectEvent(channel, ReactorEvent::READ, tasks);
+                    ++triggered;
                 }
                 if (real_events & EPOLLOUT) {
-                    channel->triggerEvent(ReactorEvent::WRITE);
-                    --pending_event_num_;
+                    collectEvent(channel, ReactorEvent::WRITE, tasks);
+                    ++triggered;
                 }
             }  // end for
+            scheduleBatch(tasks);
+            pending_event_num_ -= triggered;
 
             auto cur = Fiber::GetThis();
             auto raw_ptr = cur.get();
@@ -260,6 +385,19 @@ namespace luwu {
     }
 
     void Reactor::tickle() {
+        // 任务入队（本地队列的 bottom_ 是 relaxed 写入）必须先于读取自旋线程数量，与 spin 结束后的栅栏配对，
+        // 否则可能读到过时的自旋线程数量而跳过唤醒，自旋线程也没有看到任务
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // 自旋的线程会自己发现新任务，不需要唤醒
+        if (spinning_num_.load(std::memory_order_relaxed) > 0) {
+            skipped_tickles_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        wakeup();
+    }
+
+    void Reactor::wakeup() {
+        tickles_.fetch_add(1, std::memory_order_relaxed);
         eventfd_write(wakeup_fd_, 1);
     }
 
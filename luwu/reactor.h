@@ -6,6 +6,7 @@
 #define LUWU_REACTOR_H
 
 #include <atomic>
+#include <sys/epoll.h>
 #include "utils/noncopyable.h"
 #include "scheduler.h"
 #include "clock.h"
@@ -33,7 +34,9 @@ namespace luwu {
         struct EventCallback {
             Scheduler *scheduler_ = nullptr;
             Fiber::ptr fiber_;
-            std::function<void()> func_;
+            Fiber::fiber_func func_;
+            /// 回调函数是否直接在调度协程上执行
+            bool inline_ = false;
         };
 
         /**
@@ -63,6 +66,13 @@ namespace luwu {
          */
         void triggerEvent(ReactorEvent::Event event);
 
+        /**
+         * @brief 取出对应事件的回调并清除该事件，由调用者负责调度
+         * @param event 事件
+         * @return 取出的回调
+         */
+        EventCallback takeEvent(ReactorEvent::Event event);
+
         /// socket 描述符
         int fd_;
         /// 感兴趣的事件，多个事件用 | 连接
@@ -83,6 +93,24 @@ namespace luwu {
     public:
         using ptr = std::shared_ptr<Reactor>;
 
+        /**
+         * @brief 反应堆运行指标的快照，在调度器指标之外增加 IO 和定时器相关的指标
+         * @details tickles_ 是实际发出的唤醒次数，wakeups_ - empty_wakeups_ 是确实需要的唤醒次数，
+         * 两者相差很多说明唤醒了太多线程
+         */
+        struct Metrics : Scheduler::Metrics {
+            /// 每次从 epoll_wait 返回时得到的事件数量分布，包括 eventfd 唤醒事件
+            Histogram::Snapshot events_per_wakeup_;
+            /// 执行的定时器回调数量
+            uint64_t timers_fired_ = 0;
+            /// 写 eventfd 发出的唤醒次数
+            uint64_t tickles_ = 0;
+            /// 有线程在自旋而省掉的唤醒次数
+            uint64_t skipped_tickles_ = 0;
+            /// 等待中的 IO 事件数量
+            uint32_t pending_events_ = 0;
+        };
+
     public:
         /**
          * @brief 构造函数
@@ -92,6 +120,19 @@ namespace luwu {
          */
         explicit Reactor(std::string name, uint32_t thread_num = 0, bool use_caller = true);
 
+        /**
+         * @brief 构造使用弹性线程池的反应堆，参数含义见 Scheduler::setElastic
+         * @param name 调度器名称
+         * @param min_thread_num 最少保留的子线程数量，也是启动时的子线程数量
+         * @param max_thread_num 最多的子线程数量
+         * @param use_caller 调度器所在线程是否作为调度线程
+         * @param max_queue_delay 排队延迟目标，单位毫秒
+         * @param idle_timeout 子线程连续空闲超过该时间（毫秒）后退出
+         * @details 反应堆在构造函数中启动，弹性线程池需要在启动之前设置，所以单独提供这个构造函数
+         */
+        Reactor(std::string name, uint32_t min_thread_num, uint32_t max_thread_num, bool use_caller,
+                uint64_t max_queue_delay = 10, uint64_t idle_timeout = 30000);
+
         /**
          * @brief 析构函数
          */
@@ -102,9 +143,11 @@ namespace luwu {
          * @param fd socket 描述符
          * @param event 感兴趣的事件
          * @param cb 事件对应的回调
+         * @param inline_task 回调是否直接在调度协程上执行，只能用于一定不会阻塞的回调
          * @return 操作是否成功
          */
-        bool addEvent(int fd, ReactorEvent::Event event, const std::function<void()>& cb = nullptr);
+        bool addEvent(int fd, ReactorEvent::Event event, Fiber::fiber_func cb = nullptr,
+                      bool inline_task = false);
 
         /**
          * @brief 将 fd 的 event 事件从 epoll 中删除
@@ -115,6 +158,29 @@ namespace luwu {
          */
         bool delEvent(int fd, ReactorEvent::Event event, bool trigger = false);
 
+        /**
+         * @brief 获取包括 IO 和定时器指标在内的运行指标快照，任意线程都可以调用
+         * @return 快照
+         * @details 与 Scheduler::getMetrics 名称不同，避免通过 Scheduler 指针调用时拿到缺少反应堆指标的快照而不自知
+         */
+        Metrics getReactorMetrics() const;
+
+        // region # Getter and Setter
+        uint64_t getSpinTime() const {
+            return spin_time_;
+        }
+
+        /**
+         * @brief 设置空闲线程进入 epoll_wait 睡眠之前最多自旋等待的时间
+         * @param spin_time 自旋时间，单位微秒，为 0 时不自旋
+         * @details 自旋期间反复检查任务队列并以超时 0 调用 epoll_wait，任务到来时不需要 eventfd 唤醒；
+         * 有线程在自旋时 tickle 直接跳过，stop 的通知除外。实际自旋时间根据最近任务到达的间隔自适应，间隔超过该值时不再自旋
+         */
+        void setSpinTime(uint64_t spin_time) {
+            spin_time_ = spin_time;
+        }
+        // endregion
+
         /**
          * @brief 获取当前线程的反应堆模型
          * @return 当前线程的反应堆模型
@@ -138,17 +204,43 @@ namespace luwu {
          */
         void tickle() override;
 
+        /**
+         * @brief 无条件写 eventfd 唤醒一个在 epoll_wait 中睡眠的线程
+         */
+        void wakeup() override;
+
         /**
          * @brief 当插入一个定时器到堆顶时需要执行的操作
          */
         void onClockInsertAtFront() override;
 
+        /**
+         * @brief 注册唤醒用的 eventfd，初始化 channel，两个构造函数共用
+         */
+        void init();
+
         /**
          * @brief 调整 std::vector<Channel *> 的大小
          * @param size 目标大小
          */
         void channelResize(size_t size);
 
+        /**
+         * @brief 空闲线程自旋等待任务或者 IO 事件
+         * @param events 保存 epoll_wait 返回的事件
+         * @param max_events 最多返回的事件数量
+         * @return 自旋期间得到的事件数量
+         */
+        int spin(epoll_event *events, int max_events);
+
+        /**
+         * @brief 取出 channel 上触发的事件回调，属于本调度器的放入 tasks 稍后批量调度，其他的直接调度
+         * @param channel 触发事件的 channel
+         * @param event 触发的事件
+         * @param tasks 本次 epoll_wait 收集到的调度任务
+         */
+        void collectEvent(Channel *channel, ReactorEvent::Event event, std::vector<SchedulerTask> &tasks);
+
     private:
         /// epoll 描述符
         int epoll_fd_;
@@ -156,6 +248,18 @@ namespace luwu {
         int wakeup_fd_;
         /// 当前等待执行的 IO 事件的数量
         std::atomic_uint32_t pending_event_num_;
+        /// 空闲线程最多自旋等待的时间，单位微秒
+        uint64_t spin_time_;
+        /// 正在自旋等待的线程数量
+        std::atomic_uint32_t spinning_num_;
+        /// 每次从 epoll_wait 返回时得到的事件数量分布
+        Histogram events_per_wakeup_;
+        /// 执行的定时器回调数量
+        std::atomic<uint64_t> timers_fired_;
+        /// 写 eventfd 发出的唤醒次数
+        std::atomic<uint64_t> tickles_;
+        /// 有线程在自旋而省掉的唤醒次数
+        std::atomic<uint64_t> skipped_tickles_;
         /// epoll 所管理的所有 socket fd
         std::vector<Channel *> channels_;
         RWMutex mutex_;
@@ -3,7 +3,16 @@
 //
 
 #include "scheduler.h"
+#include <unistd.h>
+#include <csignal>
+#include <cerrno>
+#include <execinfo.h>
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+#include "logger.h"
 #include "utils/asserts.h"
+#include "utils/util.h"
 #include "hook.h"
 
 namespace luwu {
@@ -11,13 +20,89 @@ namespace luwu {
     static thread_local Scheduler *t_scheduler = nullptr;
     // 当前线程的调度协程，调度器所在线程的调度协程不是主协程，其余线程的调度协程为主协程
     static thread_local Fiber *t_scheduler_fiber = nullptr;
+    // 当前线程是否正在调度协程上直接执行函数任务
+    static thread_local bool t_in_inline_task = false;
+    // 每个线程最多缓存的执行结束的函数任务协程数量
+    static const size_t s_max_cached_fibers = 64;
+    // 当前线程在所属调度器中使用的本地队列下标，不是调度线程时为 -1
+    static thread_local uint32_t t_local_queue = -1;
+    // 选择窃取对象用的随机数状态
+    static thread_local uint32_t t_steal_seed = 0;
+    // 每从本地队列取出这么多个任务，优先检查一次全局队列，避免全局队列中的任务饿死
+    static const uint32_t s_global_check_interval = 61;
+    // 每次从注入队列中最多取出的任务数量
+    static const uint32_t s_injection_batch = 32;
+    // 后台任务最多等待这么多毫秒，之后即使还有普通任务也会提前调度一个
+    static const uint64_t s_max_background_wait = 20;
+    // 每个线程的节点池最多缓存的空闲节点数量
+    static const size_t s_max_cached_nodes = 1024;
+    // 线程局部的节点池是否已经析构，之后归还的节点直接释放
+    static thread_local bool t_node_pool_destroyed = false;
+    // 当前线程是否正在执行空闲协程，此时它也被计入空闲线程数量
+    static thread_local bool t_in_idle = false;
+    // 当前线程是否正在退出弹性线程池
+    static thread_local bool t_retiring = false;
+    // 当前线程正在执行的时间片的开始时间，单位微秒，不在执行任务时为 0，信号处理函数据此判断是否需要采集调用栈
+    static thread_local std::atomic<uint64_t> t_slice_begin{0};
+    // 当前线程的信箱，看门狗的信号处理函数把调用栈写到这里，由监控线程报告
+    static thread_local std::atomic<void *> t_watchdog_mailbox{nullptr};
+
+    /**
+     * @brief 看门狗使用的信号
+     */
+    static int WatchdogSignal() {
+        return SIGRTMIN + 2;
+    }
+
+    void Scheduler::OnWatchdogSignal(int) {
+        int saved_errno = errno;
+        auto mailbox = static_cast<Mailbox *>(t_watchdog_mailbox.load(std::memory_order_relaxed));
+        if (mailbox && t_slice_begin.load(std::memory_order_relaxed)) {
+            int frame_num = ::backtrace(mailbox->watchdog_frames_, MAX_WATCHDOG_FRAMES);
+            mailbox->watchdog_frame_num_.store(frame_num, std::memory_order_release);
+        }
+        errno = saved_errno;
+    }
+
+    struct WatchdogSignalInit {
+        explicit WatchdogSignalInit(void (*handler)(int)) {
+            // 第一次调用 backtrace 时会加载 libgcc 并分配内存，提前调用一次，之后在信号处理函数中调用才是安全的
+            void *frame;
+            ::backtrace(&frame, 1);
+            struct sigaction action{};
+            action.sa_handler = handler;
+            action.sa_flags = SA_RESTART;
+            sigemptyset(&action.sa_mask);
+            sigaction(WatchdogSignal(), &action, nullptr);
+        }
+    };
+
+    struct Scheduler::NodePool {
+        /// 空闲节点
+        std::vector<TaskNode *> nodes_;
+
+        ~NodePool() {
+            t_node_pool_destroyed = true;
+            for (auto node : nodes_) {
+                delete node;
+            }
+        }
+    };
 
     // region # Scheduler::Scheduler()
     Scheduler::Scheduler(std::string name, uint32_t thread_num, bool use_caller)
-        : name_(std::move(name)), stopping_(false), thread_num_(thread_num)
-        , active_thread_num_(0), idle_thread_num_(0)
+        : name_(std::move(name)), stopping_(false), shared_stack_(false), numa_node_(NUMA_NONE)
+        , numa_nodes_(getNumaNodes()), next_local_queue_(0)
+        , thread_num_(thread_num), active_thread_num_(0), idle_thread_num_(0), elastic_(false)
+        , min_thread_num_(thread_num), max_thread_num_(thread_num), max_queue_delay_(0), idle_timeout_(0)
+        , spawned_thread_num_(0), started_(false), run_budget_(0), watchdog_backtrace_(false), overrun_num_(0)
         , use_caller_(use_caller), caller_tid_(-1) {
         setThreadName(name_);
+        // 每个调度线程一个本地队列，调度器所在线程参与调度时也需要一个
+        for (uint32_t i = 0; i < thread_num_ + (use_caller ? 1 : 0); ++i) {
+            local_queues_.emplace_back(new WorkStealingQueue<TaskNode *>());
+            mailboxes_.emplace_back(new Mailbox);
+        }
         // 初始化主线程的主协程，即调度器所在的协程
         Fiber::InitMainFiber();
 
@@ -44,23 +129,138 @@ namespace luwu {
             // 可能出现的时机为 use_caller_ = false
             t_scheduler = nullptr;
         }
+        // 正常停止时所有队列都已经为空，这里只是防御
+        for (auto &queue : local_queues_) {
+            while (TaskNode *node = queue->steal()) {
+                FreeNode(node);
+            }
+        }
+        for (auto &injection : injection_) {
+            while (TaskNode *node = injection.queue_.pop()) {
+                FreeNode(node);
+            }
+        }
+        for (auto &mailbox : mailboxes_) {
+            while (TaskNode *node = mailbox->queue_.pop()) {
+                FreeNode(node);
+            }
+        }
+    }
+
+    void Scheduler::setElastic(uint32_t min_thread_num, uint32_t max_thread_num, uint64_t max_queue_delay,
+                               uint64_t idle_timeout) {
+        Mutex::Lock lock(mutex_);
+        LUWU_ASSERT(threads_.empty());
+        LUWU_ASSERT(min_thread_num <= max_thread_num && max_thread_num > 0);
+        elastic_ = true;
+        min_thread_num_ = min_thread_num;
+        max_thread_num_ = max_thread_num;
+        max_queue_delay_ = std::max<uint64_t>(max_queue_delay, 1);
+        idle_timeout_ = idle_timeout;
+        thread_num_ = std::min(std::max(thread_num_.load(), min_thread_num_), max_thread_num_);
+        // 本地队列和信箱按最多的线程数量预先创建，运行期间不再增减，其他线程可以无锁地访问
+        while (local_queues_.size() < max_thread_num_ + (use_caller_ ? 1 : 0)) {
+            local_queues_.emplace_back(new WorkStealingQueue<TaskNode *>());
+            mailboxes_.emplace_back(new Mailbox);
+        }
+    }
+
+    void Scheduler::setWatchdog(uint64_t run_budget, bool backtrace) {
+        if (run_budget && backtrace) {
+            static WatchdogSignalInit s_watchdog_signal_init(OnWatchdogSignal);
+        }
+        Mutex::Lock lock(mutex_);
+        watchdog_backtrace_ = backtrace;
+        run_budget_ = run_budget;
+        // Reactor 在构造函数中就已经启动，这时按需补上监控线程
+        if (run_budget && started_ && !monitor_ && !stopping_) {
+            monitor_.reset(new Thread(name_ + "_monitor", std::bind(&Scheduler::monitor, this)));
+        }
+    }
+
+    Histogram::Snapshot Scheduler::getSliceHistogram() const {
+        Histogram::Snapshot snapshot;
+        for (auto &mailbox : mailboxes_) {
+            snapshot.merge(mailbox->slices_.snapshot());
+        }
+        return snapshot;
+    }
+
+    Scheduler::Metrics Scheduler::getMetrics() const {
+        Metrics metrics;
+        metrics.time_us_ = getElapseUs();
+        for (int i = 0; i < PRIORITY_NUM; ++i) {
+            metrics.injected_depth_[i] = injection_[i].size_.load(std::memory_order_relaxed);
+            metrics.queue_depth_ += metrics.injected_depth_[i];
+        }
+        for (size_t i = 0; i < mailboxes_.size(); ++i) {
+            const Mailbox &mailbox = *mailboxes_[i];
+            ThreadMetrics thread;
+            thread.queue_depth_ = static_cast<int64_t>(local_queues_[i]->size())
+                                  + mailbox.size_.load(std::memory_order_relaxed);
+            thread.resumes_ = mailbox.dispatched_.load(std::memory_order_relaxed);
+            thread.wakeups_ = mailbox.wakeups_.load(std::memory_order_relaxed);
+            thread.empty_wakeups_ = mailbox.empty_wakeups_.load(std::memory_order_relaxed);
+            metrics.queue_depth_ += thread.queue_depth_;
+            metrics.resumes_ += thread.resumes_;
+            metrics.wakeups_ += thread.wakeups_;
+            metrics.empty_wakeups_ += thread.empty_wakeups_;
+            metrics.waits_.merge(mailbox.waits_.snapshot());
+            metrics.slices_.merge(mailbox.slices_.snapshot());
+
+            // 退出了弹性线程池或者还没有进入调度的线程只计入累计值
+            thread.tid_ = mailbox.tid_.load(std::memory_order_acquire);
+            if (!thread.tid_) {
+                continue;
+            }
+            uint64_t start = mailbox.start_us_.load(std::memory_order_relaxed);
+            uint64_t idle_begin = mailbox.idle_begin_us_.load(std::memory_order_relaxed);
+            thread.idle_us_ = mailbox.idle_us_.load(std::memory_order_relaxed);
+            // 正在空闲的这一段还没有累加进去
+            if (idle_begin && metrics.time_us_ > idle_begin) {
+                thread.idle_us_ += metrics.time_us_ - idle_begin;
+            }
+            uint64_t total = metrics.time_us_ > start ? metrics.time_us_ - start : 0;
+            thread.busy_us_ = total > thread.idle_us_ ? total - thread.idle_us_ : 0;
+            metrics.threads_.push_back(thread);
+        }
+        return metrics;
     }
 
     void Scheduler::start() {
         Mutex::Lock lock(mutex_);
 
         LUWU_ASSERT(threads_.empty());
-        threads_.resize(thread_num_);
+        started_ = true;
         // 创建对应数量的子线程，子线程的入口函数也是子线程主协程的入口函数
-        for (int i = 0; i < thread_num_; ++i) {
-            threads_[i].reset(
-                    new Thread(name_ + "_" + std::to_string(i), std::bind(&Scheduler::run, this))
-            );
+        for (uint32_t i = 0; i < thread_num_; ++i) {
+            spawnThread();
+        }
+        if (elastic_ || run_budget_) {
+            monitor_.reset(new Thread(name_ + "_monitor", std::bind(&Scheduler::monitor, this)));
+        }
+        // 启动之前指定给非调度线程的任务没有线程会取走，改为不指定线程调度，否则调度器无法停止；
+        // 子线程还在等待 mutex_ 登记信箱，进入调度后自然会看到注入队列中的任务，不需要通知
+        for (auto it = tasks_.begin(); it != tasks_.end();) {
+            if (isWorker(it->tid_)) {
+                ++it;
+                continue;
+            }
+            LUWU_LOG_ERROR(LUWU_LOG_ROOT()) << name_ << " task pinned to thread " << it->tid_
+                                            << ", which is not a scheduling thread, run it on any thread";
+            it->tid_ = -1;
+            inject(AllocNode(std::move(*it)));
+            it = tasks_.erase(it);
         }
     }
 
     void Scheduler::stop() {
         stopping_ = true;
+        // 先停止监控线程，之后子线程数量不再增加
+        if (monitor_) {
+            monitor_->join();
+            monitor_.reset();
+        }
 
         // Scheduler::stop() 会在主线程的主协程内被调用
         // use_caller_ = true，GetThis() 才有值，否则其为 nullptr
@@ -70,14 +270,14 @@ namespace luwu {
             LUWU_ASSERT(GetThis() != this);
         }
 
-        // 通知所有子线程的调度协程退出调度
+        // 通知所有子线程的调度协程退出调度，不能因为某个线程在自旋而跳过，否则其他线程要等到超时才能退出
         for (int i = 0; i < thread_num_; ++i) {
-            tickle();
+            wakeup();
         }
 
         // 通知主线程的调度协程退出调度
         if (caller_fiber_) {
-            tickle();
+            wakeup();
         }
 
         // 在 use_caller_ = true 的情况下，调度器退出时要调用 caller_fiber_
@@ -89,6 +289,8 @@ namespace luwu {
         {
             Mutex::Lock lock(mutex_);
             threads.swap(threads_);
+            threads.insert(threads.end(), exited_threads_.begin(), exited_threads_.end());
+            exited_threads_.clear();
         }
         // 等待所有任务都调度完成后才可以退出
         for (auto &t : threads) {
@@ -96,10 +298,577 @@ namespace luwu {
         }
     }
 
+    Scheduler::NodePool &Scheduler::LocalNodePool() {
+        static thread_local NodePool pool;
+        return pool;
+    }
+
+    Scheduler::TaskNode *Scheduler::AllocNode(SchedulerTask &&task) {
+        TaskNode *node;
+        auto &nodes = LocalNodePool().nodes_;
+        if (!t_node_pool_destroyed && !nodes.empty()) {
+            node = nodes.back();
+            nodes.pop_back();
+        } else {
+            node = new TaskNode;
+        }
+        node->task_ = std::move(task);
+        // 暂存在全局队列中的任务转移到信箱时保留原来的入队时间
+        if (!node->task_.enqueue_us_) {
+            node->task_.enqueue_us_ = getElapseUs();
+        }
+        return node;
+    }
+
+    void Scheduler::FreeNode(TaskNode *node) {
+        node->task_.reset();
+        if (!t_node_pool_destroyed) {
+            auto &nodes = LocalNodePool().nodes_;
+            if (nodes.size() < s_max_cached_nodes) {
+                nodes.push_back(node);
+                return;
+            }
+        }
+        delete node;
+    }
+
+    void Scheduler::schedule(SchedulerTask task) {
+        if (!task.fiber_ && !task.func_) {
+            return;
+        }
+        // 协程还没有完全切换出去时只记录唤醒，由切换完成后的 resume 调用者重新调度
+        if (task.fiber_ && !task.fiber_->wake(task.tid_)) {
+            return;
+        }
+        if (task.tid_ == -1) {
+            TaskNode *node = AllocNode(std::move(task));
+            // 本调度器的调度线程添加的普通函数任务放入自己的本地队列，不需要加锁；队列由空变为非空并且有空闲线程时通知它来窃取。
+            // 被唤醒的协程放入先进先出的注入队列，重新加入调度器再 yield 的协程不会被本地队列立即取回而饿死其他任务
+            if (node->task_.priority_ == NORMAL && !node->task_.fiber_ && t_scheduler == this && t_local_queue != -1) {
+                auto &queue = local_queues_[t_local_queue];
+                bool tickle_me = queue->empty() && idle_thread_num_ > 0;
+                queue->push(node);
+                if (tickle_me) {
+                    tickle();
+                }
+                return;
+            }
+            // 外部线程添加的任务，以及其他优先级的任务，无锁地放入对应的注入队列
+            if (inject(node)) {
+                tickle();
+            }
+            return;
+        }
+        if (pin(std::move(task))) {
+            tickle();
+        }
+    }
+
+    void Scheduler::scheduleBatch(std::vector<SchedulerTask> &tasks) {
+        bool local = t_scheduler == this && t_local_queue != -1;
+        // 不指定线程的任务：调度线程把普通任务逐个放入本地队列，其余按优先级先链接成一串，最后每个优先级一次放入注入队列
+        TaskNode *first[PRIORITY_NUM] = {};
+        TaskNode *last[PRIORITY_NUM] = {};
+        int64_t chained[PRIORITY_NUM] = {};
+        int64_t unpinned = 0;
+        // 指定了线程的任务直接放入对应的信箱，只有所属线程空闲时才需要通知
+        size_t pinned_tickles = 0;
+        for (auto &task : tasks) {
+            if (!task.fiber_ && !task.func_) {
+                continue;
+            }
+            if (task.fiber_ && !task.fiber_->wake(task.tid_)) {
+                continue;
+            }
+            if (task.tid_ != -1) {
+                pinned_tickles += pin(std::move(task)) ? 1 : 0;
+                continue;
+            }
+            TaskNode *node = AllocNode(std::move(task));
+            ++unpinned;
+            Priority priority = node->task_.priority_;
+            if (local && priority == NORMAL && !node->task_.fiber_) {
+                local_queues_[t_local_queue]->push(node);
+                continue;
+            }
+            node->next_.store(nullptr, std::memory_order_relaxed);
+            if (last[priority]) {
+                last[priority]->next_.store(node, std::memory_order_relaxed);
+            } else {
+                first[priority] = node;
+            }
+            last[priority] = node;
+            ++chained[priority];
+        }
+        tasks.clear();
+
+        // 队列由空变为非空时至少通知一次，避免正要进入空闲的线程错过这批任务
+        bool must_tickle = false;
+        for (int i = 0; i < PRIORITY_NUM; ++i) {
+            if (first[i]) {
+                must_tickle |= inject(first[i], last[i], chained[i]);
+            }
+        }
+        size_t count = unpinned + pinned_tickles;
+        if (count == 0) {
+            return;
+        }
+
+        // 只唤醒需要的空闲线程，正在执行空闲协程的本线程稍后会自己处理，不算在内
+        size_t idle = idle_thread_num_;
+        if (t_in_idle && t_scheduler == this && idle > 0) {
+            --idle;
+        }
+        size_t tickle_num = std::min(count, std::max(idle, pinned_tickles));
+        if (tickle_num == 0 && must_tickle) {
+            tickle_num = 1;
+        }
+        for (size_t i = 0; i < tickle_num; ++i) {
+            tickle();
+        }
+    }
+
+    bool Scheduler::inject(TaskNode *node) {
+        node->next_.store(nullptr, std::memory_order_relaxed);
+        return inject(node, node, 1);
+    }
+
+    bool Scheduler::inject(TaskNode *first, TaskNode *last, int64_t count) {
+        InjectionQueue &injection = injection_[first->task_.priority_];
+        // 先增加计数再放入，消费者和 stopping() 看到的数量不会少于队列中实际的任务数
+        bool was_empty = injection.size_.fetch_add(count) == 0;
+        if (was_empty) {
+            injection.served_ms_.store(getElapseMs(), std::memory_order_relaxed);
+        }
+        injection.queue_.push(first, last);
+        return was_empty;
+    }
+
+    bool Scheduler::popInjectedTask(SchedulerTask &task, Priority priority) {
+        InjectionQueue &injection = injection_[priority];
+        if (injection.size_.load(std::memory_order_relaxed) == 0) {
+            return false;
+        }
+        // 注入队列只允许一个消费者，其他线程正在取时直接放弃，去别处找任务
+        bool expect = false;
+        if (!injection.draining_.compare_exchange_strong(expect, true, std::memory_order_acquire)) {
+            return false;
+        }
+        TaskNode *first = injection.queue_.pop();
+        int64_t popped = first ? 1 : 0;
+        if (first && priority == NORMAL) {
+            // 其余任务放入本地队列，本线程逐个执行，空闲线程也可以窃取
+            auto &queue = local_queues_[t_local_queue];
+            for (uint32_t i = 1; i < s_injection_batch; ++i) {
+                TaskNode *node = injection.queue_.pop();
+                if (!node) {
+                    break;
+                }
+                queue->push(node);
+                ++popped;
+            }
+        }
+        if (first && priority == BACKGROUND) {
+            injection.served_ms_.store(getElapseMs(), std::memory_order_relaxed);
+        }
+        injection.draining_.store(false, std::memory_order_release);
+        injection.size_ -= popped;
+
+        if (!first) {
+            return false;
+        }
+        task = std::move(first->task_);
+        FreeNode(first);
+        return true;
+    }
+
+    bool Scheduler::isBackgroundStarving() {
+        InjectionQueue &injection = injection_[BACKGROUND];
+        if (injection.size_.load(std::memory_order_relaxed) == 0) {
+            return false;
+        }
+        return getElapseMs() - injection.served_ms_.load(std::memory_order_relaxed) >= s_max_background_wait;
+    }
+
+    Scheduler::Mailbox *Scheduler::findMailbox(uint32_t tid) {
+        for (auto &mailbox : mailboxes_) {
+            if (mailbox->tid_.load(std::memory_order_acquire) == tid) {
+                return mailbox.get();
+            }
+        }
+        return nullptr;
+    }
+
+    bool Scheduler::pin(SchedulerTask &&task) {
+        // 先增加数量再确认信箱仍然属于该线程，与 retire 先注销信箱再检查数量配对，两边至少有一边能看到对方
+        Mailbox *mailbox = findMailbox(task.tid_);
+        if (mailbox) {
+            mailbox->size_.fetch_add(1);
+            if (mailbox->tid_.load() != task.tid_) {
+                --mailbox->size_;
+                mailbox = nullptr;
+            }
+        }
+        if (!mailbox) {
+            // 线程进入调度时会在锁内登记并转移全局队列中的任务，这里加锁再查一次，保证任务不会遗留在全局队列中
+            Mutex::Lock lock(mutex_);
+            mailbox = findMailbox(task.tid_);
+            if (!mailbox && !isWorker(task.tid_)) {
+                // 指定的线程已经退出弹性线程池（或者根本不是调度线程），暂存起来永远没有线程取走，调度器也无法停止，
+                // 改为不指定线程调度
+                LUWU_LOG_ERROR(LUWU_LOG_ROOT()) << name_ << " task pinned to thread " << task.tid_
+                                                << ", which is not a scheduling thread (retired?), run it on any thread";
+                task.tid_ = -1;
+                return inject(AllocNode(std::move(task)));
+            }
+            if (!mailbox) {
+                task.enqueue_us_ = getElapseUs();
+                tasks_.push_back(std::move(task));
+                return false;
+            }
+            mailbox->size_.fetch_add(1);
+        }
+        // 先增加数量再读取空闲标记，与所属线程先置空闲标记再检查数量配对，两边至少有一边能看到对方
+        mailbox->queue_.push(AllocNode(std::move(task)));
+        return mailbox->idle_.load();
+    }
+
+    bool Scheduler::isWorker(uint32_t tid) const {
+        // 启动之前还不知道子线程的线程 id，只能先暂存
+        if (!started_ || (use_caller_ && tid == caller_tid_)) {
+            return true;
+        }
+        for (auto &thread : threads_) {
+            if (thread->getId() == tid) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool Scheduler::popMailboxTask(SchedulerTask &task) {
+        Mailbox &mailbox = *mailboxes_[t_local_queue];
+        if (mailbox.size_.load(std::memory_order_relaxed) == 0) {
+            return false;
+        }
+        // 生产者正在放入时可能暂时取不到，所属线程稍后再取
+        TaskNode *node = mailbox.queue_.pop();
+        if (!node) {
+            return false;
+        }
+        --mailbox.size_;
+        task = std::move(node->task_);
+        FreeNode(node);
+        return true;
+    }
+
+    bool Scheduler::hasIdleMailbox() {
+        for (uint32_t i = 0; i < mailboxes_.size(); ++i) {
+            if (i != t_local_queue && mailboxes_[i]->idle_ && mailboxes_[i]->size_ > 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool Scheduler::popLocalTask(SchedulerTask &task, bool oldest) {
+        auto &queue = local_queues_[t_local_queue];
+        // 所属线程也可以从顶部窃取，与其他线程的窃取竞争失败时直接放弃
+        TaskNode *node = oldest ? queue->steal() : queue->pop();
+        if (!node) {
+            return false;
+        }
+        task = std::move(node->task_);
+        FreeNode(node);
+        return true;
+    }
+
+    bool Scheduler::stealTask(SchedulerTask &task) {
+        auto size = static_cast<uint32_t>(local_queues_.size());
+        // xorshift 随机选择起点，避免所有空闲线程都去窃取同一个线程
+        t_steal_seed ^= t_steal_seed << 13;
+        t_steal_seed ^= t_steal_seed >> 17;
+        t_steal_seed ^= t_steal_seed << 5;
+        uint32_t start = t_steal_seed % size;
+        // NUMA_SPREAD 时第一轮只窃取同一节点的线程，避免协程和它访问的内存分处两个节点
+        int passes = numa_node_ == NUMA_SPREAD && numa_nodes_.size() > 1 ? 2 : 1;
+        for (int pass = 0; pass < passes; ++pass) {
+            for (uint32_t i = 0; i < size; ++i) {
+                uint32_t victim = (start + i) % size;
+                if (victim == t_local_queue || (pass == 0 && passes == 2 && nodeOf(victim) != nodeOf(t_local_queue))) {
+                    continue;
+                }
+                TaskNode *node = local_queues_[victim]->steal();
+                if (node) {
+                    task = std::move(node->task_);
+                    FreeNode(node);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void Scheduler::spawnThread() {
+        threads_.emplace_back(new Thread(name_ + "_" + std::to_string(spawned_thread_num_++),
+                                         std::bind(&Scheduler::run, this)));
+    }
+
+    bool Scheduler::retire() {
+        Mutex::Lock lock(mutex_);
+        // 共享栈协程只能回到原来的线程继续执行，线程退出之后它们就无法恢复了
+        if (stopping_ || shared_stack_ || thread_num_ <= min_thread_num_ || !local_queues_[t_local_queue]->empty()) {
+            return false;
+        }
+        // 先注销信箱再检查数量，与 pin 配对；已经有任务放进来时恢复信箱，继续留在线程池中
+        Mailbox &mailbox = *mailboxes_[t_local_queue];
+        uint32_t tid = mailbox.tid_.exchange(0);
+        if (mailbox.size_.load() != 0) {
+            mailbox.tid_.store(tid);
+            return false;
+        }
+        --thread_num_;
+        for (auto it = threads_.begin(); it != threads_.end(); ++it) {
+            if (it->get() == Thread::GetThis()) {
+                exited_threads_.push_back(std::move(*it));
+                threads_.erase(it);
+                break;
+            }
+        }
+        return true;
+    }
+
+    void Scheduler::monitor() {
+        // 每个信箱上次看到的任务数量和看到它变化的时间
+        std::vector<uint64_t> dispatched(mailboxes_.size(), 0);
+        std::vector<uint64_t> progress_ms(mailboxes_.size(), getElapseMs());
+        // 每个信箱看门狗已经报告过的时间片
+        std::vector<uint64_t> reported(mailboxes_.size(), 0);
+        std::vector<uint64_t> dumped(mailboxes_.size(), 0);
+        uint64_t backlog_since = 0;
+        uint64_t last_spawn = 0;
+        while (true) {
+            // 弹性扩容每半个延迟目标检查一次，看门狗每四分之一个时间上限检查一次
+            uint64_t run_budget = run_budget_;
+            uint64_t interval = elastic_ ? std::max<uint64_t>(max_queue_delay_ / 2, 1) : 1000;
+            if (run_budget) {
+                interval = std::min(interval, std::max<uint64_t>(run_budget / 4, 1));
+            }
+            usleep(static_cast<useconds_t>(interval * 1000));
+            std::vector<Thread::ptr> exited;
+            {
+                Mutex::Lock lock(mutex_);
+                if (stopping_) {
+                    break;
+                }
+                exited.swap(exited_threads_);
+            }
+            for (auto &thread : exited) {
+                thread->join();
+            }
+
+            if (run_budget) {
+                watch(reported, dumped);
+            }
+            if (!elastic_) {
+                continue;
+            }
+
+            uint64_t now = getElapseMs();
+            // 有线程执行同一个任务超过延迟目标，计算密集或者阻塞在没有 hook 的调用中，它本地队列中的任务只能等待
+            bool stalled = false;
+            for (size_t i = 0; i < mailboxes_.size(); ++i) {
+                Mailbox &mailbox = *mailboxes_[i];
+                uint64_t count = mailbox.dispatched_.load(std::memory_order_relaxed);
+                if (count != dispatched[i] || mailbox.idle_ || mailbox.tid_ == 0) {
+                    dispatched[i] = count;
+                    progress_ms[i] = now;
+                    continue;
+                }
+                stalled |= now - progress_ms[i] >= max_queue_delay_;
+            }
+
+            // 有空闲线程时积压的任务很快会被取走，增加线程没有意义
+            if (idle_thread_num_ != 0 || !hasReadyTask()) {
+                backlog_since = 0;
+                continue;
+            }
+            if (!backlog_since) {
+                backlog_since = now;
+            }
+            // 每个延迟周期最多增加一个线程，给新线程时间消化积压
+            if ((!stalled && now - backlog_since < max_queue_delay_) || now - last_spawn < max_queue_delay_) {
+                continue;
+            }
+            Mutex::Lock lock(mutex_);
+            if (stopping_ || thread_num_ >= max_thread_num_) {
+                continue;
+            }
+            ++thread_num_;
+            spawnThread();
+            last_spawn = now;
+            backlog_since = now;
+        }
+    }
+
+    void Scheduler::watch(std::vector<uint64_t> &reported, std::vector<uint64_t> &dumped) {
+        uint64_t budget = run_budget_ * 1000;
+        uint64_t now = getElapseUs();
+        for (size_t i = 0; i < mailboxes_.size(); ++i) {
+            Mailbox &mailbox = *mailboxes_[i];
+            uint64_t begin = mailbox.slice_begin_.load(std::memory_order_acquire);
+            if (!begin || now < begin + budget || mailbox.tid_ == 0) {
+                continue;
+            }
+            // 名称在时间片开始之前写好，读完之后时间片没有变化才是这个任务的名称
+            char name[MAX_SLICE_NAME_LEN];
+            memcpy(name, mailbox.slice_name_, sizeof(name));
+            name[sizeof(name) - 1] = '\0';
+            uint32_t fiber_id = mailbox.slice_fiber_.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (mailbox.slice_begin_.load(std::memory_order_relaxed) != begin) {
+                continue;
+            }
+            std::stringstream ss;
+            ss << name_ << " watchdog: ";
+            if (fiber_id) {
+                ss << "fiber " << fiber_id << " [" << name << "]";
+            } else {
+                ss << "inline task";
+            }
+            ss << " on thread " << mailbox.tid_;
+
+            // 任务可能一直不让出，先报告一次，同时让所在线程采集调用栈
+            if (begin != reported[i]) {
+                reported[i] = begin;
+                ss << " has been running for " << (now - begin) / 1000 << " ms without yielding, budget "
+                   << run_budget_ << " ms";
+                LUWU_LOG_ERROR(LUWU_LOG_ROOT()) << ss.str();
+                if (watchdog_backtrace_) {
+                    pthread_kill(mailbox.thread_, WatchdogSignal());
+                }
+                continue;
+            }
+            // 之后的检查中报告信号处理函数采集到的调用栈
+            int frame_num = mailbox.watchdog_frame_num_.load(std::memory_order_acquire);
+            if (begin == dumped[i] || !frame_num) {
+                continue;
+            }
+            void *frames[MAX_WATCHDOG_FRAMES];
+            memcpy(frames, mailbox.watchdog_frames_, sizeof(void *) * frame_num);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (mailbox.slice_begin_.load(std::memory_order_relaxed) != begin) {
+                continue;
+            }
+            dumped[i] = begin;
+            // 跳过信号处理函数和信号返回跳板两层
+            ss << " is still running after " << (now - begin) / 1000 << " ms, backtrace when it was caught:"
+               << std::endl << backtraceToString(frames, frame_num, 2, "    ");
+            LUWU_LOG_ERROR(LUWU_LOG_ROOT()) << ss.str();
+        }
+    }
+
+    void Scheduler::beginSlice(Mailbox &mailbox, Fiber *fiber) {
+        uint64_t now = getElapseUs();
+        mailbox.watchdog_frame_num_.store(0, std::memory_order_relaxed);
+        t_slice_begin.store(now, std::memory_order_relaxed);
+        mailbox.slice_fiber_.store(fiber ? fiber->getId() : 0, std::memory_order_relaxed);
+        size_t len = fiber ? std::min(fiber->getName().size(), MAX_SLICE_NAME_LEN - 1) : 0;
+        if (len) {
+            memcpy(mailbox.slice_name_, fiber->getName().data(), len);
+        }
+        mailbox.slice_name_[len] = '\0';
+        mailbox.slice_begin_.store(now, std::memory_order_release);
+    }
+
+    void Scheduler::endSlice(Mailbox &mailbox, Fiber *fiber) {
+        uint64_t begin = mailbox.slice_begin_.load(std::memory_order_relaxed);
+        mailbox.slice_begin_.store(0, std::memory_order_relaxed);
+        t_slice_begin.store(0, std::memory_order_relaxed);
+        uint64_t slice = getElapseUs() - begin;
+        mailbox.slices_.record(slice);
+
+        uint64_t budget = run_budget_;
+        if (!budget || slice < budget * 1000) {
+            return;
+        }
+        ++overrun_num_;
+        std::stringstream ss;
+        ss << name_ << " watchdog: ";
+        if (fiber) {
+            ss << "fiber " << fiber->getId() << " [" << fiber->getName() << "]";
+        } else {
+            ss << "inline task";
+        }
+        ss << " ran " << slice / 1000 << " ms without yielding, budget " << budget << " ms";
+        int frame_num = mailbox.watchdog_frame_num_.load(std::memory_order_acquire);
+        if (frame_num) {
+            // 跳过信号处理函数和信号返回跳板两层
+            ss << ", backtrace when it was caught:" << std::endl
+               << backtraceToString(mailbox.watchdog_frames_, frame_num, 2, "    ");
+        }
+        LUWU_LOG_ERROR(LUWU_LOG_ROOT()) << ss.str();
+    }
+
+    void Scheduler::place(uint32_t index) {
+        int node = numa_node_ == NUMA_SPREAD ? nodeOf(index) : numa_node_;
+        if (!cpu_affinity_.empty()) {
+            int cpu = cpu_affinity_[index % cpu_affinity_.size()];
+            if (!setThreadAffinity({cpu})) {
+                LUWU_LOG_ERROR(LUWU_LOG_ROOT()) << name_ << " bind thread to cpu " << cpu << " failed";
+            }
+        } else if (node >= 0 && !setThreadAffinity(getNumaNodeCpus(node))) {
+            LUWU_LOG_ERROR(LUWU_LOG_ROOT()) << name_ << " bind thread to numa node " << node << " failed";
+        }
+        if (node >= 0 && !setThreadNumaNode(node)) {
+            LUWU_LOG_ERROR(LUWU_LOG_ROOT()) << name_ << " set memory policy to numa node " << node << " failed";
+        }
+    }
+
+    int Scheduler::nodeOf(uint32_t index) const {
+        return numa_node_ == NUMA_SPREAD ? numa_nodes_[index % numa_nodes_.size()] : 0;
+    }
+
+    bool Scheduler::hasReadyTask() {
+        for (auto &injection : injection_) {
+            if (injection.size_.load(std::memory_order_relaxed) != 0) {
+                return true;
+            }
+        }
+        // 其他线程本地队列中的任务可以窃取，其他空闲线程信箱中的任务需要本线程回到调度循环去传递通知
+        for (auto &queue : local_queues_) {
+            if (!queue->empty()) {
+                return true;
+            }
+        }
+        if (t_local_queue != -1 && mailboxes_[t_local_queue]->size_.load(std::memory_order_relaxed) != 0) {
+            return true;
+        }
+        return hasIdleMailbox();
+    }
+
     bool Scheduler::stopping() {
         Mutex::Lock lock(mutex_);
         // 所有任务都执行结束才可以停止调度器
-        return stopping_ && tasks_.empty() && active_thread_num_ == 0;
+        if (!stopping_ || !tasks_.empty() || active_thread_num_ != 0) {
+            return false;
+        }
+        for (auto &injection : injection_) {
+            if (injection.size_ != 0) {
+                return false;
+            }
+        }
+        for (auto &queue : local_queues_) {
+            if (!queue->empty()) {
+                return false;
+            }
+        }
+        for (auto &mailbox : mailboxes_) {
+            if (mailbox->size_ != 0) {
+                return false;
+            }
+        }
+        return true;
     }
 
     void Scheduler::run() {
@@ -113,78 +882,226 @@ namespace luwu {
 
         // 空闲协程
         Fiber::ptr idle_fiber(new Fiber(std::bind(&Scheduler::idle, this)));
+        // 本线程缓存的执行结束的函数任务协程，线程退出调度时一起释放
+        std::vector<Fiber::ptr> fiber_cache;
+
+        // 本线程的本地队列，优先复用弹性线程池中已经退出的线程留下的
+        {
+            Mutex::Lock lock(mutex_);
+            if (!free_local_queues_.empty()) {
+                t_local_queue = free_local_queues_.back();
+                free_local_queues_.pop_back();
+            } else {
+                t_local_queue = next_local_queue_++;
+            }
+        }
+        LUWU_ASSERT(t_local_queue < local_queues_.size());
+        // 调度器创建的子线程按照设置绑定 CPU 和 NUMA 节点，之后创建的协程和协程栈都在本节点分配
+        if (getThreadId() != caller_tid_) {
+            place(t_local_queue);
+        }
+        t_steal_seed = getThreadId() | 1;
+        // 登记本线程的信箱，进入调度之前指定在本线程执行的任务从全局队列转移过来
+        Mailbox &mailbox = *mailboxes_[t_local_queue];
+        {
+            Mutex::Lock lock(mutex_);
+            mailbox.thread_ = pthread_self();
+            // 弹性线程池中信箱会被新线程复用，运行指标从新线程进入调度时重新计算
+            mailbox.start_us_.store(getElapseUs(), std::memory_order_relaxed);
+            mailbox.idle_us_.store(0, std::memory_order_relaxed);
+            mailbox.tid_.store(getThreadId(), std::memory_order_release);
+            t_watchdog_mailbox.store(&mailbox, std::memory_order_relaxed);
+            for (auto it = tasks_.begin(); it != tasks_.end();) {
+                if (it->tid_ == getThreadId()) {
+                    mailbox.size_.fetch_add(1);
+                    mailbox.queue_.push(AllocNode(std::move(*it)));
+                    it = tasks_.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        uint32_t tick = 0;
+        // 信箱开始执行的任务数量，弹性线程池中接着复用该信箱的上一个线程继续累计
+        uint64_t dispatched = mailbox.dispatched_.load(std::memory_order_relaxed);
+        // 弹性模式下本线程连续空闲的开始时间，为 0 表示刚执行过任务
+        uint64_t idle_since = 0;
+        // 本线程是否退出了弹性线程池
+        bool retired = false;
+        // 本线程是否刚从空闲协程返回，用于统计多余的唤醒
+        bool woken = false;
 
         static thread_local SchedulerTask task;
         while (true) {
             task.reset();
             // 是否需要 tickle 其他协程进行任务调度
             bool tickle_me = false;
-            {
-                Mutex::Lock lock(mutex_);
-                auto it = tasks_.begin();
-                while (it != tasks_.end()) {
-                    // 指定了某个线程进行调度，但是不是本线程，所以需要通知其他线程
-                    if (it->tid_ != -1 && it->tid_ != getThreadId()) {
-                        ++it;
-                        tickle_me = true;
-                        continue;
-                    }
-
-                    // [BUG FIX]: hook IO 相关的系统调用时，在检测到 IO 未就绪的情况下，会先添加对应的读写事件，再 yield 当前协程，
-                    // 等 IO 就绪后再 resume 当前协程。多线程高并发情境下，有可能发生刚添加事件就被触发的情况，如果此时当前协程还未来得及
-                    // yield，则这里就有可能出现协程状态仍为 RUNNING 的情况。这里简单地跳过这种情况，以损失一点性能为代价，
-                    // 否则整个协程框架都要大改
-                    if (it->fiber_ && it->fiber_->getState() == Fiber::RUNNING) {
-                        ++it;
-                        continue;
-                    }
-
-                    // 找到了一个合法的任务
-                    LUWU_ASSERT(it->fiber_ || it->func_);
-                    task = *it;
-                    tasks_.erase(it++);             // 这里必须要 ++，否则指针不变下面无法判断是否到达 tasks_.end()
-                    ++active_thread_num_;
-                    break;
+            // 查找任务期间也算作活跃线程，避免其他线程在任务从队列中取出、还没有开始执行时误判调度器可以停止
+            ++active_thread_num_;
+            // 先取延迟敏感的任务，后台任务等待太久时提前取一个，然后依次从本地队列、信箱、注入队列、其他线程的本地队列中获取任务，
+            // 最后才是后台任务。每隔一段时间先检查一次信箱和普通注入队列，再取本地队列中最早放入的任务，
+            // 避免它们被本地队列中不断放入的新任务和延迟敏感的任务饿死
+            bool found;
+            if (++tick % s_global_check_interval == 0) {
+                found = popMailboxTask(task) || popInjectedTask(task, NORMAL) || popInjectedTask(task, CRITICAL)
+                        || popLocalTask(task, true);
+            } else {
+                found = popInjectedTask(task, CRITICAL)
+                        || (isBackgroundStarving() && popInjectedTask(task, BACKGROUND))
+                        || popLocalTask(task) || popMailboxTask(task) || popInjectedTask(task, NORMAL);
+            }
+            found = found || stealTask(task) || popInjectedTask(task, BACKGROUND);
+            if (woken) {
+                mailbox.wakeups_.fetch_add(1, std::memory_order_relaxed);
+                if (!found) {
+                    mailbox.empty_wakeups_.fetch_add(1, std::memory_order_relaxed);
                 }
-                // 当前调度协程拿走一个任务后，还有剩余任务，也需要通知其他线程继续调度
-                tickle_me |= (it != tasks_.end());
+                woken = false;
+            }
+            if (found) {
+                mailbox.dispatched_.store(++dispatched, std::memory_order_relaxed);
+                idle_since = 0;
+                uint64_t now = getElapseUs();
+                mailbox.waits_.record(now > task.enqueue_us_ ? now - task.enqueue_us_ : 0);
+            } else {
+                --active_thread_num_;
+                // 通知可能被本线程接收了，而信箱中有任务的线程还在空闲，需要把通知传递下去
+                tickle_me = hasIdleMailbox();
             }
 
+            // 本地队列中还有任务，通知空闲线程来窃取
+            tickle_me |= idle_thread_num_ > 0 && !local_queues_[t_local_queue]->empty();
             if (tickle_me) {
                 tickle();
             }
 
+            // 开启看门狗时记录每个时间片的开始时间和长度
+            bool watched = run_budget_.load(std::memory_order_relaxed) != 0;
             if (task.fiber_) {                                          // 协程直接调度
-                task.fiber_->resume();
+                // hook IO 时先添加读写事件再 yield，多线程下事件可能在 yield 完成之前就触发了，
+                // 这种唤醒被记录在协程状态中，切换完成之后在这里重新调度，不会丢失
+                if (watched) {
+                    beginSlice(mailbox, task.fiber_.get());
+                }
+                bool notified = task.fiber_->resume();
+                if (watched) {
+                    endSlice(mailbox, task.fiber_.get());
+                }
+                if (notified) {
+                    schedule(SchedulerTask(task.fiber_, task.fiber_->getPendingThread()));
+                }
+                --active_thread_num_;
+            } else if (task.func_ && task.inline_) {                    // 直接在调度协程上执行，不创建协程
+                if (watched) {
+                    beginSlice(mailbox, nullptr);
+                }
+                t_in_inline_task = true;
+                task.func_();
+                t_in_inline_task = false;
+                // 任务设置的协程局部变量保存在调度协程上，清除掉，避免泄漏给之后的内联任务
+                t_scheduler_fiber->clearLocals();
+                if (watched) {
+                    endSlice(mailbox, nullptr);
+                }
                 --active_thread_num_;
             } else if (task.func_) {
-                Fiber::ptr func_fiber(new Fiber(task.func_));   // 函数封装成协程再调度
-                func_fiber->resume();
+                // 函数封装成协程再调度，优先复用本线程缓存的已经执行结束的协程，避免重新分配协程和协程栈
+                Fiber::ptr func_fiber;
+                uint32_t stack_size = task.stack_size_ ? task.stack_size_ : Fiber::STACK_DEFAULT;
+                for (auto it = fiber_cache.rbegin(); it != fiber_cache.rend(); ++it) {
+                    if ((*it)->isSharedStack() == shared_stack_
+                        && (shared_stack_ || (*it)->getStackSize() == stack_size)) {
+                        func_fiber.swap(*it);
+                        fiber_cache.erase(std::next(it).base());
+                        break;
+                    }
+                }
+                if (func_fiber) {
+                    func_fiber->reset(std::move(task.func_));
+                } else {
+                    func_fiber.reset(new Fiber(std::move(task.func_), true, stack_size, shared_stack_));
+                }
+                func_fiber->setPriority(task.priority_);
+                if (watched) {
+                    beginSlice(mailbox, func_fiber.get());
+                }
+                bool notified = func_fiber->resume();
+                if (watched) {
+                    endSlice(mailbox, func_fiber.get());
+                }
+                if (notified) {
+                    schedule(SchedulerTask(func_fiber, func_fiber->getPendingThread()));
+                }
                 --active_thread_num_;
+                // 协程执行结束并且没有其他地方持有该协程，可以放回缓存；否则协程中途 yield 了，由持有者负责后续调度
+                if (func_fiber->getState() == Fiber::TERM && func_fiber.use_count() == 1
+                    && fiber_cache.size() < s_max_cached_fibers) {
+                    fiber_cache.push_back(std::move(func_fiber));
+                }
             } else {                                                    // 没有任务了，进入到 idle 协程
                 if (idle_fiber->getState() == Fiber::TERM) {            // idle 协程在满足退出条件后会退出，执行状态变成 TERM
                     break;
                 }
+                if (elastic_ && !idle_since) {
+                    idle_since = getElapseMs();
+                }
                 ++idle_thread_num_;
-                idle_fiber->resume();
+                t_in_idle = true;
+                // 置空闲标记之后再检查一次信箱，与 pin 配对，避免错过通知
+                mailbox.idle_ = true;
+                if (mailbox.size_ == 0) {
+                    uint64_t idle_begin = getElapseUs();
+                    mailbox.idle_begin_us_.store(idle_begin, std::memory_order_relaxed);
+                    idle_fiber->resume();
+                    mailbox.idle_begin_us_.store(0, std::memory_order_relaxed);
+                    mailbox.idle_us_.fetch_add(getElapseUs() - idle_begin, std::memory_order_relaxed);
+                    woken = true;
+                }
+                mailbox.idle_ = false;
+                t_in_idle = false;
                 --idle_thread_num_;
+
+                // 弹性模式下空闲太久的子线程退出，调度器所在线程不退出
+                if (elastic_ && getThreadId() != caller_tid_ && getElapseMs() - idle_since >= idle_timeout_
+                    && retire()) {
+                    // 空闲协程看到退出标记后结束
+                    t_retiring = true;
+                    idle_fiber->resume();
+                    t_retiring = false;
+                    retired = true;
+                    break;
+                }
             }
         }
+        // 退出调度之后才能把本地队列交给新线程
+        if (retired) {
+            Mutex::Lock lock(mutex_);
+            free_local_queues_.push_back(t_local_queue);
+        }
+        t_local_queue = -1;
     }
 
     void Scheduler::idle() {
         // 此处的 idle 协程什么都不做，进来就退出
         // 调度器可以停止时，就会退出 while 循环，idle 协程就执行结束了，协程状态变味了 TERM
         // 之后 Scheduler::run() 的 while(true) 就会结束
-        while (!stopping()) {
+        while (!stopping() && !retiring()) {
             Fiber::GetThis()->yield();
         }
     }
 
+    bool Scheduler::retiring() const {
+        return t_retiring;
+    }
+
     void Scheduler::tickle() {
 
     }
 
+    void Scheduler::wakeup() {
+        tickle();
+    }
+
     Scheduler *Scheduler::GetThis() {
         return t_scheduler;
     }
@@ -196,4 +1113,16 @@ namespace luwu {
     Fiber *Scheduler::GetSchedulerFiber() {
         return t_scheduler_fiber;
     }
+
+    bool Scheduler::InInlineTask() {
+        return t_in_inline_task;
+    }
+
+    bool Scheduler::InTaskFiber() {
+        if (!t_scheduler || t_in_inline_task || Fiber::GetFiberId() == static_cast<uint32_t>(-1)) {
+            return false;
+        }
+        // 线程主协程和调度协程都不参与调度，挂起它们没有人能恢复
+        return Fiber::GetThis()->isRunInScheduler();
+    }
 }
\ No newline at end of file
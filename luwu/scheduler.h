@@ -12,6 +12,9 @@
 #include "fiber.h"
 #include "utils/mutex.h"
 #include "utils/noncopyable.h"
+#include "utils/histogram.h"
+#include "utils/mpsc_queue.h"
+#include "utils/work_stealing_queue.h"
 
 namespace luwu {
     /**
@@ -21,6 +24,25 @@ namespace luwu {
     public:
         using ptr = std::shared_ptr<Scheduler>;
 
+        /// 不限制子线程所在的 NUMA 节点
+        static const int NUMA_NONE = -1;
+        /// 子线程按编号轮流分配到各个 NUMA 节点
+        static const int NUMA_SPREAD = -2;
+
+        /**
+         * @brief 调度优先级
+         */
+        enum Priority {
+            /// 延迟敏感的任务，例如健康检查、accept、定时器回调，总是最先调度
+            CRITICAL = 0,
+            /// 普通任务
+            NORMAL = 1,
+            /// 后台批量任务，没有其他任务时才调度，等待太久时提前调度一个，避免饿死
+            BACKGROUND = 2,
+            /// 优先级数量
+            PRIORITY_NUM = 3,
+        };
+
         /**
          * @brief 构造函数
          * @param name 调度器名称
@@ -45,28 +67,229 @@ namespace luwu {
          */
         void stop();
 
+        /**
+         * @brief 开启弹性线程池，需要在 start 之前设置
+         * @param min_thread_num 最少保留的子线程数量
+         * @param max_thread_num 最多的子线程数量
+         * @param max_queue_delay 排队延迟目标，单位毫秒
+         * @param idle_timeout 子线程连续空闲超过该时间（毫秒）后退出
+         * @details 启动时创建的子线程数量为构造时的 thread_num，限制在 [min_thread_num, max_thread_num] 之内。
+         * 监控线程定期检查，没有空闲线程并且任务持续积压超过 max_queue_delay，或者有线程执行同一个任务超过 max_queue_delay
+         * （计算密集或者阻塞在没有 hook 的调用中）并且还有任务在等待时，增加一个子线程；空闲太久的子线程退出，不少于 min_thread_num。
+         * 子线程的线程 id 不固定，指定线程的任务只应指定给调度器所在线程；指定给已经退出的子线程的任务会输出错误日志，
+         * 改为不指定线程调度。使用共享栈时协程绑定在线程上，子线程不会退出。
+         * Reactor 在构造函数中启动，使用它的弹性构造函数
+         */
+        void setElastic(uint32_t min_thread_num, uint32_t max_thread_num, uint64_t max_queue_delay = 10,
+                        uint64_t idle_timeout = 30000);
+
+        /**
+         * @brief 开启看门狗，检查长时间不让出的协程，可以在启动之后设置
+         * @param run_budget 任务一次连续运行的时间上限，单位毫秒，为 0 时关闭
+         * @param backtrace 是否采集超时任务的调用栈
+         * @details 开启后调度线程记录每次 resume 的开始时间和时间片长度。监控线程发现有任务连续运行超过 run_budget 时
+         * 立即输出一次告警（协程 id、时间片开始时的协程名称和线程 id），并向该线程发送信号，在信号处理函数中把调用栈
+         * 采集到该线程的信箱里，下一次检查时输出，任务一直不让出也能看到它停在哪里；任务让出之后，所在线程再输出协程 id、
+         * 当前的协程名称（servlet 名称）、时间片长度和采集到的调用栈。
+         * 信号使用 SIGRTMIN + 2，并且设置了 SA_RESTART，但是 sleep 这类会被信号打断的系统调用仍然可能提前返回，
+         * 不希望这样时关闭 backtrace
+         */
+        void setWatchdog(uint64_t run_budget, bool backtrace = true);
+
+        /**
+         * @brief 所有调度线程执行任务的时间片长度分布，单位微秒，只在看门狗开启期间记录
+         * @return 直方图快照
+         */
+        Histogram::Snapshot getSliceHistogram() const;
+
+        /**
+         * @brief 单个调度线程的运行指标
+         */
+        struct ThreadMetrics {
+            /// 线程 id
+            uint32_t tid_ = 0;
+            /// 本地队列和信箱中等待的任务数量
+            int64_t queue_depth_ = 0;
+            /// 开始执行的任务数量，包括协程每次被唤醒后的恢复执行
+            uint64_t resumes_ = 0;
+            /// 进入调度以来的忙碌时间，单位微秒，包括查找任务的时间
+            uint64_t busy_us_ = 0;
+            /// 进入调度以来在空闲协程中的时间，单位微秒
+            uint64_t idle_us_ = 0;
+            /// 从空闲协程返回的次数
+            uint64_t wakeups_ = 0;
+            /// 返回之后没有取到任务的次数，即多余的唤醒
+            uint64_t empty_wakeups_ = 0;
+        };
+
+        /**
+         * @brief 调度器运行指标的快照
+         * @details 计数都是累计值，速率由两次快照相减再除以 time_us_ 之差得到，例如每秒 resume 次数。
+         * 排队延迟看 waits_，任务本身的执行时间看 slices_，据此区分延迟来自排队还是来自处理函数
+         */
+        struct Metrics {
+            /// 获取快照的时间，单位微秒
+            uint64_t time_us_ = 0;
+            /// 各优先级注入队列中等待的任务数量
+            int64_t injected_depth_[PRIORITY_NUM] = {};
+            /// 所有队列中等待的任务数量，不包括指定在还没有进入调度的线程上执行的任务
+            int64_t queue_depth_ = 0;
+            /// 开始执行的任务数量
+            uint64_t resumes_ = 0;
+            /// 从空闲协程返回的次数
+            uint64_t wakeups_ = 0;
+            /// 返回之后没有取到任务的次数
+            uint64_t empty_wakeups_ = 0;
+            /// 任务从入队到开始执行的等待时间分布，单位微秒
+            Histogram::Snapshot waits_;
+            /// 任务一次连续执行的时间分布，单位微秒，只在看门狗开启期间记录
+            Histogram::Snapshot slices_;
+            /// 每个调度线程的指标
+            std::vector<ThreadMetrics> threads_;
+        };
+
+        /**
+         * @brief 获取运行指标的快照，任意线程都可以调用，不加锁
+         * @return 快照
+         */
+        Metrics getMetrics() const;
+
         /**
          * @brief 向调度器添加调度任务
          * @tparam Task 调度任务类型，可以是协程或者函数
          * @param t 协程或者函数
          * @param tid 指定在某一个线程执行
+         * @param stack_size 任务为函数时，封装该函数的协程的栈大小，为 0 时使用默认大小
          */
         template<typename Task>
-        void addTask(Task t, uint32_t tid = -1) {
-            bool tickle_me;
-            {
-                Mutex::Lock lock(mutex_);
-                tickle_me = tasks_.empty();
-                SchedulerTask task(t, tid);
-                if (task.fiber_ || task.func_) {
-                    tasks_.push_back(task);
-                }
+        void addTask(Task t, uint32_t tid = -1, uint32_t stack_size = 0) {
+            schedule(SchedulerTask(std::move(t), tid, stack_size));
+        }
+
+        /**
+         * @brief 按指定的优先级向调度器添加调度任务
+         * @tparam Task 调度任务类型，可以是协程或者函数
+         * @param t 协程或者函数
+         * @param priority 优先级，函数任务的协程之后被唤醒时也按该优先级调度
+         * @param tid 指定在某一个线程执行，指定了线程的任务进入该线程的信箱，不区分优先级
+         * @param stack_size 任务为函数时，封装该函数的协程的栈大小，为 0 时使用默认大小
+         */
+        template<typename Task>
+        void addTask(Task t, Priority priority, uint32_t tid = -1, uint32_t stack_size = 0) {
+            SchedulerTask task(std::move(t), tid, stack_size);
+            task.priority_ = priority;
+            schedule(std::move(task));
+        }
+
+        /**
+         * @brief 向调度器添加一个直接在调度协程上执行的函数任务
+         * @param func 函数
+         * @param tid 指定在某一个线程执行
+         * @details 不创建协程，没有协程栈，也没有上下文切换，适用于定时器簿记、唤醒事件处理等一定不会阻塞的小任务。
+         * 任务内不允许 yield（包括 hook 之后的阻塞 IO、sleep），否则断言失败；任务内设置的协程局部变量在任务返回后被清除
+         */
+        void addInlineTask(Fiber::fiber_func func, uint32_t tid = -1) {
+            SchedulerTask task(std::move(func), tid);
+            task.inline_ = true;
+            schedule(std::move(task));
+        }
+
+        /**
+         * @brief 向调度器批量添加调度任务
+         * @tparam Iterator 迭代器类型，解引用得到协程或者函数
+         * @param begin 起始迭代器
+         * @param end 结束迭代器
+         * @param tid 指定在某一个线程执行
+         * @param stack_size 任务为函数时，封装该函数的协程的栈大小，为 0 时使用默认大小
+         * @details 整批任务一次入队：调度线程把函数任务放入本地队列，其余任务一次原子交换链入注入队列，指定线程的任务只加一次锁；
+         * 之后最多通知 min(任务数量, 空闲线程数量) 次，而不是每个任务都通知一次。
+         * 函数（包括只能移动的 Fiber::fiber_func）和协程指针从区间中移走，调用之后区间中的元素处于被移走的状态；
+         * 常量迭代器的元素只能复制，要求元素可以复制
+         */
+        template<typename Iterator>
+        void addTasks(Iterator begin, Iterator end, uint32_t tid = -1, uint32_t stack_size = 0) {
+            std::vector<SchedulerTask> tasks;
+            for (; begin != end; ++begin) {
+                tasks.emplace_back(std::move(*begin), tid, stack_size);
             }
-            if (tickle_me) {
-                tickle();
+            scheduleBatch(tasks);
+        }
+
+        /**
+         * @brief 按指定的优先级向调度器批量添加调度任务，参数含义同上
+         */
+        template<typename Iterator>
+        void addTasks(Iterator begin, Iterator end, Priority priority, uint32_t tid = -1, uint32_t stack_size = 0) {
+            std::vector<SchedulerTask> tasks;
+            for (; begin != end; ++begin) {
+                tasks.emplace_back(std::move(*begin), tid, stack_size);
+                tasks.back().priority_ = priority;
             }
+            scheduleBatch(tasks);
+        }
+
+        // region # Getter and Setter
+        uint32_t getThreadNum() const {
+            return thread_num_;
+        }
+
+        bool isElastic() const {
+            return elastic_;
+        }
+
+        uint64_t getRunBudget() const {
+            return run_budget_;
         }
 
+        /**
+         * @brief 超过看门狗时间上限的时间片数量
+         */
+        uint64_t getOverrunNum() const {
+            return overrun_num_;
+        }
+
+        bool isSharedStack() const {
+            return shared_stack_;
+        }
+
+        /**
+         * @brief 设置函数任务是否运行在共享栈协程上，需要在添加任务之前设置
+         * @param shared_stack 是否使用共享栈
+         * @details 共享栈模式下大量空闲协程（例如空闲的 websocket 连接）只占用实际用到的栈空间，代价是每次切换都要拷贝栈
+         */
+        void setSharedStack(bool shared_stack) {
+            shared_stack_ = shared_stack;
+        }
+
+        const std::vector<int> &getCpuAffinity() const {
+            return cpu_affinity_;
+        }
+
+        /**
+         * @brief 设置子线程绑定的 CPU，需要在 start 之前设置
+         * @param cpus CPU 编号，第 i 个子线程绑定到 cpus[i % cpus.size()]，为空时不绑定
+         * @details 只影响调度器创建的子线程，调度器所在线程是用户的线程，不会被修改
+         */
+        void setCpuAffinity(std::vector<int> cpus) {
+            cpu_affinity_ = std::move(cpus);
+        }
+
+        int getNumaNode() const {
+            return numa_node_;
+        }
+
+        /**
+         * @brief 设置子线程所在的 NUMA 节点，需要在 start 之前设置
+         * @param node 节点编号，也可以是 NUMA_NONE 或者 NUMA_SPREAD（轮流分配到在线的节点）
+         * @details 子线程只在该节点的 CPU 上运行（同时设置了 setCpuAffinity 时以其为准），并且优先从该节点分配内存，
+         * 子线程创建的协程、协程栈和缓冲区都留在本节点。多路服务器上可以每个节点一个 Reactor，各自设置自己的节点；
+         * NUMA_SPREAD 时窃取任务优先选择同一节点的线程
+         */
+        void setNumaNode(int node) {
+            numa_node_ = node;
+        }
+        // endregion
+
     protected:
         /**
          * @brief 调度器是否可以停止
@@ -85,30 +308,28 @@ namespace luwu {
         virtual void idle();
 
         /**
-         * @brief 通知协程调度器有调度任务需要执行了
+         * @brief 本线程是否正在退出弹性线程池，空闲协程看到后应当尽快返回
+         * @return 是否正在退出
          */
-        virtual void tickle();
+        bool retiring() const;
 
-    public:
         /**
-         * @brief 获取当前线程所属的调度器
-         * @return 当前线程所属的调度器
+         * @brief 通知协程调度器有调度任务需要执行了
          */
-        static Scheduler *GetThis();
+        virtual void tickle();
 
         /**
-         * @brief 设置当前线程所属的调度器
-         * @param scheduler 当前线程所属的调度器
+         * @brief 无条件唤醒一个空闲线程，不会因为有线程在自旋而跳过
+         * @details stop 通知每个线程退出调度时使用，默认与 tickle 相同
          */
-        static void SetThis(Scheduler *scheduler);
+        virtual void wakeup();
 
         /**
-         * @brief 获得当前线程的调度协程
-         * @return 当前线程的调度协程
+         * @brief 当前线程是否有可以取到的任务，空闲协程自旋等待时用来判断是否可以结束等待
+         * @return 是否有任务
          */
-        static Fiber *GetSchedulerFiber();
+        bool hasReadyTask();
 
-    private:
         /**
          * @brief 调度任务，可以是协程或者函数
          */
@@ -116,46 +337,393 @@ namespace luwu {
             /// 协程
             Fiber::ptr fiber_;
             /// 函数
-            std::function<void()> func_;
+            Fiber::fiber_func func_;
             /// 指定在某个线程运行
             uint32_t tid_;
+            /// 函数封装成协程时的栈大小
+            uint32_t stack_size_;
+            /// 函数是否直接在调度协程上执行
+            bool inline_;
+            /// 调度优先级
+            Priority priority_;
+            /// 入队时间，单位微秒，用于统计排队延迟
+            uint64_t enqueue_us_;
 
-            SchedulerTask() : fiber_(nullptr), func_(nullptr), tid_(-1) {}
+            SchedulerTask() : fiber_(nullptr), func_(nullptr), tid_(-1), stack_size_(0), inline_(false)
+                , priority_(NORMAL), enqueue_us_(0) {}
 
-            explicit SchedulerTask(Fiber::ptr fiber, uint32_t tid = -1)
-                : fiber_(std::move(fiber)), func_(nullptr), tid_(tid) {
+            explicit SchedulerTask(Fiber::ptr fiber, uint32_t tid = -1, uint32_t stack_size = 0)
+                : fiber_(std::move(fiber)), func_(nullptr), tid_(tid), stack_size_(stack_size), inline_(false)
+                , priority_(NORMAL), enqueue_us_(0) {
+                if (fiber_) {
+                    // 协程按自己的优先级重新调度
+                    priority_ = static_cast<Priority>(fiber_->getPriority());
+                    // 共享栈协程运行过之后只能回到原来的线程继续执行
+                    if (tid_ == static_cast<uint32_t>(-1) && fiber_->isSharedStack()) {
+                        tid_ = fiber_->getBoundThread();
+                    }
+                }
             }
 
-            explicit SchedulerTask(std::function<void()> func, uint32_t tid = -1)
-                : fiber_(nullptr), func_(std::move(func)), tid_(tid) {
+            explicit SchedulerTask(Fiber::fiber_func func, uint32_t tid = -1, uint32_t stack_size = 0)
+                : fiber_(nullptr), func_(std::move(func)), tid_(tid), stack_size_(stack_size), inline_(false)
+                , priority_(NORMAL), enqueue_us_(0) {
             }
 
             void reset() {
                 fiber_ = nullptr;
                 func_ = nullptr;
                 tid_ = -1;
+                stack_size_ = 0;
+                inline_ = false;
+                priority_ = NORMAL;
+                enqueue_us_ = 0;
             }
         };
 
+        /**
+         * @brief 将一批调度任务加入任务队列，最多通知实际需要的空闲线程数量次
+         * @param tasks 调度任务，调用之后被移走
+         */
+        void scheduleBatch(std::vector<SchedulerTask> &tasks);
+
+    public:
+        /**
+         * @brief 获取当前线程所属的调度器
+         * @return 当前线程所属的调度器
+         */
+        static Scheduler *GetThis();
+
+        /**
+         * @brief 设置当前线程所属的调度器
+         * @param scheduler 当前线程所属的调度器
+         */
+        static void SetThis(Scheduler *scheduler);
+
+        /**
+         * @brief 获得当前线程的调度协程
+         * @return 当前线程的调度协程
+         */
+        static Fiber *GetSchedulerFiber();
+
+        /**
+         * @brief 当前线程是否正在调度协程上直接执行函数任务
+         * @return 是否正在执行 addInlineTask 添加的任务
+         */
+        static bool InInlineTask();
+
+        /**
+         * @brief 当前是否运行在调度器调度的任务协程中，只有这时才可以挂起当前协程等待
+         * @return 是否在任务协程中；不在调度线程上、在线程主协程或者调度协程上（例如 use_caller 调度器所在线程的 main 函数中）、
+         * 在 addInlineTask 添加的任务中时返回 false
+         */
+        static bool InTaskFiber();
+
+    private:
+        /**
+         * @brief 任务队列中的节点，节点由线程局部的节点池分配和回收，入队出队时不需要分配内存
+         */
+        struct TaskNode {
+            /// 调度任务
+            SchedulerTask task_;
+            /// 注入队列中的下一个节点
+            std::atomic<TaskNode *> next_{nullptr};
+        };
+
+        /// 看门狗采集的调用栈的最大深度
+        static const int MAX_WATCHDOG_FRAMES = 32;
+        /// 看门狗报告中协程名称的最大长度（包括结尾的 '\0'）
+        static const size_t MAX_SLICE_NAME_LEN = 32;
+
+        /**
+         * @brief 每个调度线程一个的信箱，存放指定在该线程执行的任务，任意线程放入，只有所属线程取出
+         */
+        struct Mailbox {
+            /// 指定在所属线程执行的任务
+            MpscQueue<TaskNode> queue_;
+            /// 信箱中的任务数量，放入之前增加，取出之后减少
+            std::atomic<int64_t> size_{0};
+            /// 所属线程的线程 id，线程进入调度之前为 0
+            std::atomic_uint32_t tid_{0};
+            /// 所属线程是否正在执行空闲协程，只有这时才需要通知它
+            std::atomic_bool idle_{false};
+            /// 所属线程开始执行的任务数量，监控线程据此判断线程是否长时间停在同一个任务上
+            std::atomic<uint64_t> dispatched_{0};
+            /// 所属线程的 pthread 句柄，看门狗向它发送信号采集调用栈
+            pthread_t thread_{};
+            /// 所属线程正在执行的时间片的开始时间，单位微秒，不在执行任务时为 0
+            std::atomic<uint64_t> slice_begin_{0};
+            /// 所属线程正在执行的协程 id，直接在调度协程上执行的任务为 0
+            std::atomic_uint32_t slice_fiber_{0};
+            /// 所属线程正在执行的协程在时间片开始时的名称，截断到固定长度，监控线程不能访问协程对象
+            char slice_name_[MAX_SLICE_NAME_LEN]{};
+            /// 看门狗的信号处理函数在所属线程采集到的调用栈
+            void *watchdog_frames_[MAX_WATCHDOG_FRAMES]{};
+            /// 采集到的调用栈深度，所属线程开始新的时间片时清零
+            std::atomic<int> watchdog_frame_num_{0};
+            /// 所属线程的时间片长度分布，单位微秒
+            Histogram slices_;
+            /// 所属线程进入调度的时间，单位微秒
+            std::atomic<uint64_t> start_us_{0};
+            /// 所属线程累计在空闲协程中的时间，单位微秒
+            std::atomic<uint64_t> idle_us_{0};
+            /// 所属线程本次进入空闲协程的时间，不在空闲协程中时为 0
+            std::atomic<uint64_t> idle_begin_us_{0};
+            /// 所属线程从空闲协程返回的次数
+            std::atomic<uint64_t> wakeups_{0};
+            /// 所属线程从空闲协程返回之后没有取到任务的次数
+            std::atomic<uint64_t> empty_wakeups_{0};
+            /// 所属线程取到的任务从入队到开始执行的等待时间分布，单位微秒
+            Histogram waits_;
+        };
+
+        /**
+         * @brief 每个优先级一个的注入队列，任意线程放入，同一时刻只有一个线程取出
+         */
+        struct InjectionQueue {
+            /// 任务
+            MpscQueue<TaskNode> queue_;
+            /// 队列中的任务数量，放入之前增加，取出之后减少
+            std::atomic<int64_t> size_{0};
+            /// 是否有线程正在从队列中取任务
+            std::atomic_bool draining_{false};
+            /// 最近一次取出任务或者队列由空变为非空的时间，用来判断后台任务是否等待太久
+            std::atomic<uint64_t> served_ms_{0};
+        };
+
+        /**
+         * @brief 线程局部的空闲节点池
+         */
+        struct NodePool;
+
+        /**
+         * @brief 从本线程的节点池中分配一个节点
+         * @param task 节点中保存的任务
+         * @return 节点
+         */
+        static TaskNode *AllocNode(SchedulerTask &&task);
+
+        /**
+         * @brief 把节点归还给本线程的节点池
+         * @param node 节点
+         */
+        static void FreeNode(TaskNode *node);
+
+        /**
+         * @brief 获取本线程的节点池
+         */
+        static NodePool &LocalNodePool();
+
+        /**
+         * @brief 将调度任务加入任务队列，必要时通知其他线程
+         * @param task 调度任务
+         * @details 本调度器的调度线程添加的不指定线程的函数任务放入该线程的本地队列，外部线程添加的任务和被唤醒的协程放入无锁注入队列，
+         * 指定了线程的任务放入该线程的信箱。本地队列由所属线程后进先出地取，协程把自己重新加入调度器再 yield 时
+         * 如果放入本地队列会被立即取回，其他任务永远得不到执行，所以协程总是放到先进先出的注入队列末尾
+         */
+        void schedule(SchedulerTask task);
+
+        /**
+         * @brief 把节点放入任务优先级对应的注入队列，生产者不会阻塞
+         * @param node 节点
+         * @return 放入之前注入队列是否为空
+         */
+        bool inject(TaskNode *node);
+
+        /**
+         * @brief 把已经用 next_ 链接好的一串同一优先级的节点一次放入注入队列
+         * @param first 第一个节点
+         * @param last 最后一个节点
+         * @param count 节点数量
+         * @return 放入之前注入队列是否为空
+         */
+        bool inject(TaskNode *first, TaskNode *last, int64_t count);
+
+        /**
+         * @brief 从注入队列中取出任务，同一时刻只有一个线程可以取
+         * @param task 取出的任务
+         * @param priority 优先级
+         * @return 是否取到任务
+         * @details NORMAL 队列一次取出一批，其余放入本线程的本地队列；其他优先级每次只取一个，保持它们的优先级
+         */
+        bool popInjectedTask(SchedulerTask &task, Priority priority);
+
+        /**
+         * @brief 后台任务是否等待太久，需要提前调度
+         * @return 是否需要提前调度
+         */
+        bool isBackgroundStarving();
+
+        /**
+         * @brief 查找线程 id 对应的信箱
+         * @param tid 线程 id
+         * @return 信箱，该线程还没有进入调度时返回 nullptr
+         */
+        Mailbox *findMailbox(uint32_t tid);
+
+        /**
+         * @brief 把指定了线程的任务放入该线程的信箱，该线程还没有进入调度时暂存到全局队列
+         * @param task 调度任务
+         * @return 是否需要通知，只有所属线程空闲时才需要
+         */
+        bool pin(SchedulerTask &&task);
+
+        /**
+         * @brief 线程是否是本调度器的调度线程（包括已经创建、还没有进入调度的线程），需要持有 mutex_
+         * @param tid 线程 id
+         * @return 是否是调度线程；启动之前无法判断，总是返回 true
+         */
+        bool isWorker(uint32_t tid) const;
+
+        /**
+         * @brief 从本线程的信箱中取出一个任务
+         * @param task 取出的任务
+         * @return 是否取到任务
+         */
+        bool popMailboxTask(SchedulerTask &task);
+
+        /**
+         * @brief 是否有空闲线程的信箱中还有任务，本线程被错误地唤醒时用来把通知传递下去
+         * @return 是否有空闲线程需要通知
+         */
+        bool hasIdleMailbox();
+
+        /**
+         * @brief 弹性线程池增加一个子线程，需要持有 mutex_
+         */
+        void spawnThread();
+
+        /**
+         * @brief 本线程空闲太久，尝试退出弹性线程池
+         * @return 是否可以退出，为 true 时信箱已经注销，线程对象移到 exited_threads_
+         */
+        bool retire();
+
+        /**
+         * @brief 弹性线程池的监控线程，按照排队延迟和线程停滞情况增加子线程，回收已经退出的子线程
+         */
+        void monitor();
+
+        /**
+         * @brief 看门狗检查，报告连续运行超过时间上限的任务，由监控线程调用
+         * @details 发现超时的任务先报告协程 id 并向所在线程发送信号，下一次检查时再报告信号处理函数采集到的调用栈，
+         * 任务一直不让出时也能看到它停在哪里
+         * @param reported 每个信箱已经报告过的时间片的开始时间，同一个时间片只报告一次
+         * @param dumped 每个信箱已经报告过调用栈的时间片的开始时间
+         */
+        void watch(std::vector<uint64_t> &reported, std::vector<uint64_t> &dumped);
+
+        /**
+         * @brief 看门狗的信号处理函数，在超时任务所在的线程上执行，把该线程当前的调用栈采集到它的信箱中
+         */
+        static void OnWatchdogSignal(int);
+
+        /**
+         * @brief 看门狗开启时，本线程开始执行一个任务
+         * @param mailbox 本线程的信箱
+         * @param fiber 执行任务的协程，直接在调度协程上执行时为 nullptr
+         */
+        void beginSlice(Mailbox &mailbox, Fiber *fiber);
+
+        /**
+         * @brief 看门狗开启时，本线程的任务让出或者结束，记录时间片长度，超过时间上限时输出报告
+         * @param mailbox 本线程的信箱
+         * @param fiber 执行任务的协程，直接在调度协程上执行时为 nullptr
+         */
+        void endSlice(Mailbox &mailbox, Fiber *fiber);
+
+        /**
+         * @brief 按照 CPU 和 NUMA 设置放置本线程
+         * @param index 本线程的本地队列下标
+         */
+        void place(uint32_t index);
+
+        /**
+         * @brief 本地队列下标为 index 的线程所在的 NUMA 节点
+         * @param index 本地队列下标
+         * @return 节点编号，NUMA_SPREAD 时按下标轮流取在线的节点，否则都为 0
+         */
+        int nodeOf(uint32_t index) const;
+
+        /**
+         * @brief 从本线程的本地队列中取出一个任务
+         * @param task 取出的任务
+         * @param oldest 为 true 时从顶部取最早放入的任务，否则从底部取最新放入的任务
+         * @return 是否取到任务
+         */
+        bool popLocalTask(SchedulerTask &task, bool oldest = false);
+
+        /**
+         * @brief 从随机选择的其他线程的本地队列顶部窃取一个任务
+         * @param task 窃取到的任务
+         * @return 是否窃取成功
+         */
+        bool stealTask(SchedulerTask &task);
+
     private:
         Mutex mutex_;
         /// 调度器名称
         std::string name_;
         /// 调度器是否正在停止
         bool stopping_;
+        /// 函数任务是否运行在共享栈协程上
+        bool shared_stack_;
+        /// 子线程绑定的 CPU
+        std::vector<int> cpu_affinity_;
+        /// 子线程所在的 NUMA 节点
+        int numa_node_;
+        /// 在线的 NUMA 节点编号，不一定连续
+        std::vector<int> numa_nodes_;
 
-        /// 调度器需要调度的任务队列
+        /// 全局任务队列，暂存指定在还没有进入调度的线程上执行的任务，线程进入调度时转移到自己的信箱
         std::list<SchedulerTask> tasks_;
+        /// 每个调度线程一个的信箱，下标与本地队列相同
+        std::vector<std::unique_ptr<Mailbox>> mailboxes_;
+        /// 注入队列，NORMAL 队列存放外部线程添加的任务和被唤醒的协程，调度线程空闲时批量取到自己的本地队列；
+        /// CRITICAL 和 BACKGROUND 任务不论由谁添加都放入各自的队列，所有线程共享
+        InjectionQueue injection_[PRIORITY_NUM];
+        /// 每个调度线程一个的本地任务队列，所属线程后进先出地执行，其他线程空闲时从顶部窃取
+        std::vector<std::unique_ptr<WorkStealingQueue<TaskNode *>>> local_queues_;
+        /// 下一个进入调度的线程使用的本地队列下标
+        std::atomic_uint32_t next_local_queue_;
+        /// 已经退出的子线程留下的本地队列下标，新线程优先复用
+        std::vector<uint32_t> free_local_queues_;
 
         /// 线程池
         std::vector<Thread::ptr> threads_;
-        /// 除调度器所在线程之外的线程数量，子线程的数量，线程池的大小
-        uint32_t thread_num_;
+        /// 除调度器所在线程之外的线程数量，子线程的数量，线程池的大小；弹性模式下随负载变化
+        std::atomic_uint32_t thread_num_;
         /// 活跃线程数量
         std::atomic_uint32_t active_thread_num_;
         /// 空闲线程数量
         std::atomic_uint32_t idle_thread_num_;
 
+        /// 是否开启弹性线程池
+        bool elastic_;
+        /// 弹性模式下最少的子线程数量
+        uint32_t min_thread_num_;
+        /// 弹性模式下最多的子线程数量
+        uint32_t max_thread_num_;
+        /// 排队延迟目标，单位毫秒
+        uint64_t max_queue_delay_;
+        /// 子线程空闲超过该时间（毫秒）后退出
+        uint64_t idle_timeout_;
+        /// 创建过的子线程数量，用于子线程命名
+        uint32_t spawned_thread_num_;
+        /// 弹性模式下的监控线程
+        Thread::ptr monitor_;
+        /// 已经退出弹性线程池、等待回收的子线程
+        std::vector<Thread::ptr> exited_threads_;
+
+        /// 是否已经启动
+        bool started_;
+        /// 看门狗的时间上限，单位毫秒，为 0 时关闭
+        std::atomic<uint64_t> run_budget_;
+        /// 看门狗是否采集超时任务的调用栈
+        std::atomic_bool watchdog_backtrace_;
+        /// 超过时间上限的时间片数量
+        std::atomic<uint64_t> overrun_num_;
+
         /// 调度器所在的线程是否参数调度
         bool use_caller_;
         /// use_caller_ 为 true 时，调度器所在线程的调度协程，和线程主协程不是同一个
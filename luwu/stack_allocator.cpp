@@ -0,0 +1,95 @@
+//
+// Created by liucxi on 2022/12/3.
+//
+
+#include "stack_allocator.h"
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <cstring>
+#include <vector>
+#include <unordered_map>
+#include "logger.h"
+#include "utils/asserts.h"
+
+namespace luwu {
+    // 每种大小的栈在每个线程最多缓存的数量，超过之后直接 munmap
+    static const size_t s_max_cached_stacks = 64;
+
+    // 线程局部的空闲栈缓存是否已经析构，线程退出之后才释放的栈直接 munmap
+    static thread_local bool t_cache_destroyed = false;
+
+    /**
+     * @brief 线程局部的空闲栈缓存，线程退出时释放所有缓存的栈
+     */
+    struct StackCache {
+        /// 栈大小 -> 空闲的栈
+        std::unordered_map<size_t, std::vector<void *>> free_lists_;
+
+        ~StackCache() {
+            t_cache_destroyed = true;
+            for (auto &item : free_lists_) {
+                for (auto stack : item.second) {
+                    ::munmap(static_cast<char *>(stack) - StackAllocator::PageSize(),
+                             item.first + StackAllocator::PageSize());
+                }
+            }
+        }
+    };
+
+    static thread_local StackCache t_stack_cache;
+
+    size_t StackAllocator::PageSize() {
+        static const size_t page_size = ::sysconf(_SC_PAGESIZE);
+        return page_size;
+    }
+
+    size_t StackAllocator::RoundUp(size_t size) {
+        size_t page_size = PageSize();
+        return (size + page_size - 1) / page_size * page_size;
+    }
+
+    void *StackAllocator::Alloc(size_t size) {
+        size = RoundUp(size);
+
+        if (!t_cache_destroyed) {
+            auto &free_list = t_stack_cache.free_lists_[size];
+            if (!free_list.empty()) {
+                void *stack = free_list.back();
+                free_list.pop_back();
+                return stack;
+            }
+        }
+
+        // 多分配一页作为保护页，放在低地址处，栈从高地址向低地址增长，溢出时首先访问到保护页
+        size_t page_size = PageSize();
+        void *base = ::mmap(nullptr, size + page_size, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+        if (base == MAP_FAILED) {
+            LUWU_LOG_ERROR(LUWU_LOG_ROOT()) << "mmap fiber stack error, size = " << size
+                                            << " errno = " << errno << " errstr = " << strerror(errno);
+            LUWU_ASSERT2(false, "mmap");
+        }
+        if (::mprotect(base, page_size, PROT_NONE)) {
+            LUWU_LOG_ERROR(LUWU_LOG_ROOT()) << "mprotect fiber stack guard page error, errno = " << errno
+                                            << " errstr = " << strerror(errno);
+        }
+        return static_cast<char *>(base) + page_size;
+    }
+
+    void StackAllocator::Dealloc(void *stack, size_t size) {
+        if (!stack) {
+            return;
+        }
+        size = RoundUp(size);
+
+        if (!t_cache_destroyed) {
+            auto &free_list = t_stack_cache.free_lists_[size];
+            if (free_list.size() < s_max_cached_stacks) {
+                free_list.push_back(stack);
+                return;
+            }
+        }
+        ::munmap(static_cast<char *>(stack) - PageSize(), size + PageSize());
+    }
+}
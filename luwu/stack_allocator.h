@@ -0,0 +1,48 @@
+//
+// Created by liucxi on 2022/12/3.
+//
+
+#ifndef LUWU_STACK_ALLOCATOR_H
+#define LUWU_STACK_ALLOCATOR_H
+
+#include <cstddef>
+
+namespace luwu {
+    /**
+     * @brief 协程栈分配器
+     * @details 协程栈通过 mmap 分配，最低地址处有一个 PROT_NONE 的保护页，栈溢出时直接触发 SIGSEGV，而不是悄悄踩坏相邻内存；
+     * 使用 MAP_NORESERVE 分配，物理页在第一次访问时才真正提交；
+     * 释放的栈按大小缓存在线程局部的空闲链表中，下次分配直接复用，避免频繁 mmap/munmap
+     */
+    class StackAllocator {
+    public:
+        /**
+         * @brief 分配一个协程栈
+         * @param size 栈大小，会向上取整到页大小
+         * @return 可用栈空间的起始地址（低地址，保护页之上）
+         */
+        static void *Alloc(size_t size);
+
+        /**
+         * @brief 释放一个协程栈，优先放回当前线程的空闲链表
+         * @param stack Alloc 返回的地址
+         * @param size 分配时传入的栈大小
+         */
+        static void Dealloc(void *stack, size_t size);
+
+        /**
+         * @brief 获取系统页大小
+         * @return 页大小
+         */
+        static size_t PageSize();
+
+        /**
+         * @brief 将栈大小向上取整到页大小
+         * @param size 栈大小
+         * @return 实际可用的栈大小
+         */
+        static size_t RoundUp(size_t size);
+    };
+}
+
+#endif //LUWU_STACK_ALLOCATOR_H
@@ -10,7 +10,8 @@
 
 namespace luwu {
     TCPServer::TCPServer(std::string name, Reactor *acceptor, Reactor *worker)
-        : name_(std::move(name)), acceptor_(acceptor), worker_(worker), stop_(false) {
+        : name_(std::move(name)), acceptor_(acceptor), worker_(worker), stop_(false)
+        , stack_size_(Fiber::STACK_DEFAULT), priority_(Scheduler::NORMAL) {
         LUWU_LOG_INFO(LUWU_LOG_ROOT()) << "create a new tcp server, name = " << getName();
     }
 
@@ -40,7 +41,8 @@ namespace luwu {
 
     void TCPServer::start() {
         LUWU_ASSERT(!stop_);
-        acceptor_->addTask(std::bind(&TCPServer::handleAccept, shared_from_this()));
+        // accept 协程之后每次被唤醒都优先调度，新连接不会排在大批普通任务后面
+        acceptor_->addTask(std::bind(&TCPServer::handleAccept, shared_from_this()), Scheduler::CRITICAL);
     }
 
     void TCPServer::stop() {
@@ -57,7 +59,7 @@ namespace luwu {
             if (client) {
                 client->setRecvTimeout(s_recv_timeout);
                 client->setSendTimeout(s_send_timeout);
-                worker_->addTask(std::bind(&TCPServer::handleClient, shared_from_this(), client));
+                worker_->addTask(std::bind(&TCPServer::handleClient, shared_from_this(), client), priority_, -1, stack_size_);
             } else {
                 LUWU_LOG_ERROR(LUWU_LOG_ROOT()) << "accept errno = " << errno
                                                  << " errstr = " << strerror(errno);
@@ -48,7 +48,7 @@ namespace luwu {
          */
         void stop();
 
-        // region # Getter
+        // region # Getter and Setter
         static uint64_t getRecvTimeout() { return s_recv_timeout; }
 
         static uint64_t getSendTimeout() { return s_send_timeout; }
@@ -56,6 +56,22 @@ namespace luwu {
         const std::string &getName() const { return name_; }
 
         bool isStop() const { return stop_; }
+
+        uint32_t getStackSize() const { return stack_size_; }
+
+        /**
+         * @brief 设置处理客户端连接的协程的栈大小，大量空闲长连接时可以使用 Fiber::STACK_SMALL 节省内存
+         * @param stack_size 协程栈大小
+         */
+        void setStackSize(uint32_t stack_size) { stack_size_ = stack_size; }
+
+        Scheduler::Priority getPriority() const { return priority_; }
+
+        /**
+         * @brief 设置处理客户端连接的协程的调度优先级，健康检查等延迟敏感的服务可以使用 Scheduler::CRITICAL
+         * @param priority 调度优先级
+         */
+        void setPriority(Scheduler::Priority priority) { priority_ = priority; }
         // endregion
 
     protected:
@@ -86,6 +102,10 @@ namespace luwu {
         Socket::ptr sock_;
         /// 服务器是否停止
         bool stop_;
+        /// 处理客户端连接的协程的栈大小
+        uint32_t stack_size_;
+        /// 处理客户端连接的协程的调度优先级
+        Scheduler::Priority priority_;
     };
 }
 
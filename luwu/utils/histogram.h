@@ -0,0 +1,131 @@
+//
+// Created by liucxi on 2022/12/19.
+//
+
+#ifndef LUWU_HISTOGRAM_H
+#define LUWU_HISTOGRAM_H
+
+#include <atomic>
+#include <cstdint>
+#include "noncopyable.h"
+
+namespace luwu {
+    /**
+     * @brief 无锁直方图，桶按 2 的幂划分
+     * @details 第 0 个桶记录 0，第 i 个桶记录 [2^(i-1), 2^i) 内的值，最后一个桶记录所有更大的值。
+     * 记录只是几次 relaxed 原子加，适合放在调度循环这样的热路径上；多个线程频繁记录时每个线程使用自己的直方图，
+     * 导出时再合并，避免争用同一个缓存行。快照不是原子的，各个计数之间可能相差正在进行的几次记录
+     */
+    class Histogram : NonCopyable {
+    public:
+        /// 桶的数量
+        static const uint32_t BUCKET_NUM = 32;
+
+        /**
+         * @brief 直方图的快照，可以合并、计算分位数
+         */
+        struct Snapshot {
+            /// 记录的次数
+            uint64_t count_ = 0;
+            /// 记录的值之和
+            uint64_t sum_ = 0;
+            /// 记录过的最大值
+            uint64_t max_ = 0;
+            /// 每个桶中记录的次数
+            uint64_t buckets_[BUCKET_NUM] = {};
+
+            /**
+             * @brief 合并另一个快照
+             * @param other 另一个快照
+             */
+            void merge(const Snapshot &other) {
+                count_ += other.count_;
+                sum_ += other.sum_;
+                max_ = other.max_ > max_ ? other.max_ : max_;
+                for (uint32_t i = 0; i < BUCKET_NUM; ++i) {
+                    buckets_[i] += other.buckets_[i];
+                }
+            }
+
+            /**
+             * @brief 平均值
+             */
+            uint64_t mean() const {
+                return count_ ? sum_ / count_ : 0;
+            }
+
+            /**
+             * @brief 分位数，返回所在桶的上界，不超过最大值
+             * @param ratio 比例，例如 0.99
+             * @return 分位数，没有记录时为 0
+             */
+            uint64_t percentile(double ratio) const {
+                uint64_t target = static_cast<uint64_t>(static_cast<double>(count_) * ratio);
+                uint64_t seen = 0;
+                for (uint32_t i = 0; i < BUCKET_NUM; ++i) {
+                    seen += buckets_[i];
+                    if (seen > target || (seen == count_ && seen)) {
+                        uint64_t bound = UpperBound(i);
+                        return bound < max_ ? bound : max_;
+                    }
+                }
+                return max_;
+            }
+        };
+
+        /**
+         * @brief 记录一个值
+         * @param value 值
+         */
+        void record(uint64_t value) {
+            buckets_[BucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+            count_.fetch_add(1, std::memory_order_relaxed);
+            sum_.fetch_add(value, std::memory_order_relaxed);
+            uint64_t max = max_.load(std::memory_order_relaxed);
+            while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+            }
+        }
+
+        /**
+         * @brief 获取快照
+         * @return 快照
+         */
+        Snapshot snapshot() const {
+            Snapshot snapshot;
+            snapshot.count_ = count_.load(std::memory_order_relaxed);
+            snapshot.sum_ = sum_.load(std::memory_order_relaxed);
+            snapshot.max_ = max_.load(std::memory_order_relaxed);
+            for (uint32_t i = 0; i < BUCKET_NUM; ++i) {
+                snapshot.buckets_[i] = buckets_[i].load(std::memory_order_relaxed);
+            }
+            return snapshot;
+        }
+
+        /**
+         * @brief 值所在的桶
+         * @param value 值
+         * @return 桶的下标
+         */
+        static uint32_t BucketOf(uint64_t value) {
+            uint32_t bucket = value ? 64 - __builtin_clzll(value) : 0;
+            return bucket < BUCKET_NUM ? bucket : BUCKET_NUM - 1;
+        }
+
+        /**
+         * @brief 桶中记录的值的上界（包含）
+         * @param bucket 桶的下标
+         * @return 上界，最后一个桶没有上界，返回 UINT64_MAX
+         */
+        static uint64_t UpperBound(uint32_t bucket) {
+            return bucket + 1 < BUCKET_NUM ? (1ull << bucket) - 1 : ~0ull;
+        }
+
+    private:
+        std::atomic<uint64_t> count_{0};
+        std::atomic<uint64_t> sum_{0};
+        std::atomic<uint64_t> max_{0};
+        std::atomic<uint64_t> buckets_[BUCKET_NUM] = {};
+    };
+}
+
+#endif //LUWU_HISTOGRAM_H
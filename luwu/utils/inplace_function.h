@@ -0,0 +1,266 @@
+//
+// Created by liucxi on 2022/12/16.
+//
+
+#ifndef LUWU_INPLACE_FUNCTION_H
+#define LUWU_INPLACE_FUNCTION_H
+
+#include <new>
+#include <cstddef>
+#include <utility>
+#include <functional>
+#include <type_traits>
+#include "asserts.h"
+
+namespace luwu {
+    template<typename Signature, size_t Capacity = 48>
+    class InplaceFunction;
+
+    /**
+     * @brief 只能移动的函数包装，函数对象不超过 Capacity 字节时直接存放在对象内部，不分配内存
+     * @tparam R 返回值类型
+     * @tparam Args 参数类型
+     * @tparam Capacity 内部存储的字节数
+     * @details 用法与 std::function 相同，区别是不能拷贝，因此可以保存只能移动的函数对象。
+     * 超过容量、对齐要求更高或者移动构造可能抛出异常的函数对象退回到堆上存放，行为不变，只是多一次分配
+     */
+    template<typename R, typename... Args, size_t Capacity>
+    class InplaceFunction<R(Args...), Capacity> {
+    private:
+        /**
+         * @brief 按函数对象类型生成的操作表，每种类型一份静态实例
+         */
+        struct Ops {
+            R (*invoke)(void *storage, Args &&...args);
+            /// 移动构造到 dst，并析构 src
+            void (*relocate)(void *dst, void *src);
+            void (*destroy)(void *storage);
+        };
+
+        using Storage = typename std::aligned_storage<Capacity, alignof(void *)>::type;
+
+        template<typename F>
+        struct IsInvocable {
+        private:
+            template<typename U>
+            static auto test(int) -> decltype(std::declval<U &>()(std::declval<Args>()...));
+
+            template<typename U>
+            static void test(...);
+
+            template<typename U>
+            static auto check(int) -> decltype(std::declval<U &>()(std::declval<Args>()...), std::true_type());
+
+            template<typename U>
+            static std::false_type check(...);
+
+        public:
+            static const bool value = decltype(check<F>(0))::value
+                                      && (std::is_void<R>::value
+                                          || std::is_convertible<decltype(test<F>(0)), R>::value);
+        };
+
+        template<typename F>
+        struct FitsInline {
+            static const bool value = sizeof(F) <= sizeof(Storage) && alignof(F) <= alignof(Storage)
+                                      && std::is_nothrow_move_constructible<F>::value;
+        };
+
+    public:
+        InplaceFunction() noexcept : ops_(nullptr) {}
+
+        InplaceFunction(std::nullptr_t) noexcept : ops_(nullptr) {}
+
+        /**
+         * @brief 从任意可调用对象构造
+         * @param f 可调用对象，空函数指针和空的 std::function 得到空的 InplaceFunction
+         */
+        template<typename F, typename Functor = typename std::decay<F>::type,
+                 typename = typename std::enable_if<!std::is_same<Functor, InplaceFunction>::value
+                                                    && IsInvocable<Functor>::value>::type>
+        InplaceFunction(F &&f) : ops_(nullptr) {
+            if (isNull(f)) {
+                return;
+            }
+            store<Functor>(std::forward<F>(f), std::integral_constant<bool, FitsInline<Functor>::value>());
+        }
+
+        InplaceFunction(InplaceFunction &&other) noexcept : ops_(nullptr) {
+            moveFrom(other);
+        }
+
+        InplaceFunction &operator=(InplaceFunction &&other) noexcept {
+            if (this != &other) {
+                reset();
+                moveFrom(other);
+            }
+            return *this;
+        }
+
+        InplaceFunction &operator=(std::nullptr_t) noexcept {
+            reset();
+            return *this;
+        }
+
+        template<typename F, typename Functor = typename std::decay<F>::type,
+                 typename = typename std::enable_if<!std::is_same<Functor, InplaceFunction>::value
+                                                    && IsInvocable<Functor>::value>::type>
+        InplaceFunction &operator=(F &&f) {
+            return *this = InplaceFunction(std::forward<F>(f));
+        }
+
+        InplaceFunction(const InplaceFunction &) = delete;
+
+        InplaceFunction &operator=(const InplaceFunction &) = delete;
+
+        ~InplaceFunction() {
+            reset();
+        }
+
+        R operator()(Args... args) const {
+            // 与 std::function 相同，调用空函数时抛出 bad_function_call，关闭断言的版本中也不会解引用空指针
+            LUWU_ASSERT2(ops_, "call of an empty InplaceFunction");
+            if (!ops_) {
+                throw std::bad_function_call();
+            }
+            return ops_->invoke(const_cast<void *>(static_cast<const void *>(&storage_)), std::forward<Args>(args)...);
+        }
+
+        explicit operator bool() const noexcept {
+            return ops_ != nullptr;
+        }
+
+        /**
+         * @brief 析构保存的函数对象，之后为空
+         */
+        void reset() noexcept {
+            if (ops_) {
+                ops_->destroy(&storage_);
+                ops_ = nullptr;
+            }
+        }
+
+    private:
+        /**
+         * @brief 函数对象直接存放在 storage_ 中
+         */
+        template<typename F>
+        struct InlineOps {
+            static R invoke(void *storage, Args &&...args) {
+                return (*static_cast<F *>(storage))(std::forward<Args>(args)...);
+            }
+
+            static void relocate(void *dst, void *src) {
+                F *from = static_cast<F *>(src);
+                ::new(dst) F(std::move(*from));
+                from->~F();
+            }
+
+            static void destroy(void *storage) {
+                static_cast<F *>(storage)->~F();
+            }
+
+            static const Ops *get() {
+                static const Ops ops = {&invoke, &relocate, &destroy};
+                return &ops;
+            }
+        };
+
+        /**
+         * @brief 函数对象放在堆上，storage_ 中只存放指针
+         */
+        template<typename F>
+        struct HeapOps {
+            static R invoke(void *storage, Args &&...args) {
+                return (**static_cast<F **>(storage))(std::forward<Args>(args)...);
+            }
+
+            static void relocate(void *dst, void *src) {
+                ::new(dst) F *(*static_cast<F **>(src));
+            }
+
+            static void destroy(void *storage) {
+                delete *static_cast<F **>(storage);
+            }
+
+            static const Ops *get() {
+                static const Ops ops = {&invoke, &relocate, &destroy};
+                return &ops;
+            }
+        };
+
+        template<typename F, typename T>
+        void store(T &&f, std::true_type) {
+            ::new(&storage_) F(std::forward<T>(f));
+            ops_ = InlineOps<F>::get();
+        }
+
+        template<typename F, typename T>
+        void store(T &&f, std::false_type) {
+            ::new(&storage_) F *(new F(std::forward<T>(f)));
+            ops_ = HeapOps<F>::get();
+        }
+
+        void moveFrom(InplaceFunction &other) noexcept {
+            if (other.ops_) {
+                other.ops_->relocate(&storage_, &other.storage_);
+                ops_ = other.ops_;
+                other.ops_ = nullptr;
+            }
+        }
+
+        template<typename F>
+        static bool isNull(const F &) {
+            return false;
+        }
+
+        template<typename T>
+        static bool isNull(T *p) {
+            return p == nullptr;
+        }
+
+        template<typename Sig>
+        static bool isNull(const std::function<Sig> &f) {
+            return !f;
+        }
+
+        template<typename Sig, size_t N>
+        static bool isNull(const InplaceFunction<Sig, N> &f) {
+            return !f;
+        }
+
+        /// 函数对象或者指向堆上函数对象的指针
+        Storage storage_;
+        /// 操作表，为空时表示没有保存函数
+        const Ops *ops_;
+    };
+
+    template<typename Signature, size_t Capacity>
+    bool operator==(const InplaceFunction<Signature, Capacity> &f, std::nullptr_t) noexcept {
+        return !f;
+    }
+
+    template<typename Signature, size_t Capacity>
+    bool operator==(std::nullptr_t, const InplaceFunction<Signature, Capacity> &f) noexcept {
+        return !f;
+    }
+
+    template<typename Signature, size_t Capacity>
+    bool operator!=(const InplaceFunction<Signature, Capacity> &f, std::nullptr_t) noexcept {
+        return static_cast<bool>(f);
+    }
+
+    template<typename Signature, size_t Capacity>
+    bool operator!=(std::nullptr_t, const InplaceFunction<Signature, Capacity> &f) noexcept {
+        return static_cast<bool>(f);
+    }
+
+    /**
+     * @brief 调度器、协程、IO 事件和定时器统一使用的任务函数类型
+     * @details 容量可以放下 std::bind(&TCPServer::handleClient, shared_from_this(), client) 这样
+     * 一个成员函数指针加两个智能指针的绑定，accept 之后派发连接、IO 事件和定时器回调的路径上不需要分配内存
+     */
+    using task_func = InplaceFunction<void(), 48>;
+}
+
+#endif //LUWU_INPLACE_FUNCTION_H
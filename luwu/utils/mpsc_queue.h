@@ -0,0 +1,87 @@
+//
+// Created by liucxi on 2022/12/12.
+//
+
+#ifndef LUWU_MPSC_QUEUE_H
+#define LUWU_MPSC_QUEUE_H
+
+#include <atomic>
+#include "noncopyable.h"
+
+namespace luwu {
+    /**
+     * @brief 侵入式无锁多生产者单消费者队列
+     * @tparam Node 节点类型，需要可默认构造，并且有成员 std::atomic<Node *> next_
+     * @details 生产者只做一次原子交换，永远不会阻塞；同一时刻只能有一个消费者。
+     * 节点由调用者分配和回收，队列本身不分配内存。实现参考 Dmitry Vyukov 的 intrusive MPSC node-based queue
+     */
+    template<typename Node>
+    class MpscQueue : NonCopyable {
+    public:
+        MpscQueue() : head_(&stub_), tail_(&stub_) {
+            stub_.next_.store(nullptr, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief 放入一个节点，任意线程都可以调用
+         * @param node 节点，在被 pop 取出之前不能修改或释放
+         */
+        void push(Node *node) {
+            node->next_.store(nullptr, std::memory_order_relaxed);
+            push(node, node);
+        }
+
+        /**
+         * @brief 一次放入一串已经链接好的节点，只需要一次原子交换
+         * @param first 第一个节点
+         * @param last 最后一个节点，first 沿 next_ 可以走到 last，last->next_ 必须为空
+         */
+        void push(Node *first, Node *last) {
+            Node *prev = head_.exchange(last, std::memory_order_acq_rel);
+            // prev 与 first 链接起来之前，消费者看到的队列暂时在 prev 处断开
+            prev->next_.store(first, std::memory_order_release);
+        }
+
+        /**
+         * @brief 取出一个节点，只能由消费者调用
+         * @return 节点，队列为空或者有生产者正在放入时返回 nullptr
+         */
+        Node *pop() {
+            Node *tail = tail_;
+            Node *next = tail->next_.load(std::memory_order_acquire);
+            if (tail == &stub_) {
+                if (!next) {
+                    return nullptr;
+                }
+                tail_ = next;
+                tail = next;
+                next = next->next_.load(std::memory_order_acquire);
+            }
+            if (next) {
+                tail_ = next;
+                return tail;
+            }
+            if (tail != head_.load(std::memory_order_acquire)) {
+                return nullptr;             // 生产者交换了 head_ 但还没有链接 next_
+            }
+            // tail 是最后一个节点，放回 stub_ 之后才能把它取出来
+            push(&stub_);
+            next = tail->next_.load(std::memory_order_acquire);
+            if (next) {
+                tail_ = next;
+                return tail;
+            }
+            return nullptr;
+        }
+
+    private:
+        /// 最后放入的节点，生产者修改
+        std::atomic<Node *> head_;
+        /// 下一个取出的节点，只有消费者修改
+        Node *tail_;
+        /// 哨兵节点
+        Node stub_;
+    };
+}
+
+#endif //LUWU_MPSC_QUEUE_H
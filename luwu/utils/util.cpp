@@ -5,6 +5,11 @@
 #include "util.h"
 #include "../fiber.h"
 #include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <fstream>
+#include <cstdlib>
+#include <linux/mempolicy.h>
 #include <sys/syscall.h>
 #include <sys/time.h>
 #include <execinfo.h>
@@ -13,8 +18,19 @@
 #include <openssl/sha.h>
 
 namespace luwu {
+    // 当前线程的线程 id，第一次获取时缓存，之后不再进行系统调用
+    static thread_local uint32_t t_thread_id = 0;
+
     uint32_t getThreadId() {
-        return syscall(SYS_gettid);
+        if (!t_thread_id) {
+            static int reset_in_child = pthread_atfork(nullptr, nullptr, []() {
+                // fork 出的子进程中线程 id 变了，缓存需要失效
+                t_thread_id = 0;
+            });
+            (void)reset_in_child;
+            t_thread_id = syscall(SYS_gettid);
+        }
+        return t_thread_id;
     }
 
     uint32_t getFiberId() {
@@ -29,6 +45,13 @@ namespace luwu {
         return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
     }
 
+    uint64_t getElapseUs() {
+        struct timespec ts{};
+        // 调度循环中每次切换都会调用，CLOCK_MONOTONIC 可以通过 vDSO 读取，不陷入内核
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+    }
+
     std::string getThreadName() {
         // 系统调用要求不能超过 16 字节
         char thread_name[16];
@@ -40,6 +63,69 @@ namespace luwu {
         pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
     }
 
+    /**
+     * @brief 解析 sysfs 中 "0-3,8-11" 格式的编号列表
+     */
+    static std::vector<int> parseIdList(const std::string &path) {
+        std::vector<int> ids;
+        std::ifstream ifs(path);
+        std::string item;
+        while (std::getline(ifs, item, ',')) {
+            item = trim(item);
+            if (item.empty()) {
+                continue;
+            }
+            size_t pos = item.find('-');
+            int first = atoi(item.c_str());
+            int last = pos == std::string::npos ? first : atoi(item.c_str() + pos + 1);
+            for (int id = first; id <= last; ++id) {
+                ids.push_back(id);
+            }
+        }
+        return ids;
+    }
+
+    std::vector<int> getNumaNodes() {
+        std::vector<int> nodes = parseIdList("/sys/devices/system/node/online");
+        if (nodes.empty()) {
+            nodes.push_back(0);
+        }
+        return nodes;
+    }
+
+    std::vector<int> getNumaNodeCpus(int node) {
+        std::vector<int> cpus = parseIdList("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (cpus.empty() && node == 0) {
+            for (int i = 0; i < sysconf(_SC_NPROCESSORS_CONF); ++i) {
+                cpus.push_back(i);
+            }
+        }
+        return cpus;
+    }
+
+    bool setThreadAffinity(const std::vector<int> &cpus) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus) {
+            if (cpu >= 0 && cpu < CPU_SETSIZE) {
+                CPU_SET(cpu, &set);
+            }
+        }
+        if (CPU_COUNT(&set) == 0) {
+            return false;
+        }
+        return pthread_setaffinity_np(pthread_self(), sizeof set, &set) == 0;
+    }
+
+    bool setThreadNumaNode(int node) {
+        if (node < 0 || node >= static_cast<int>(sizeof(unsigned long) * 8)) {
+            return false;
+        }
+        // 直接使用系统调用，不依赖 libnuma
+        unsigned long mask = 1ul << node;
+        return syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask, sizeof(mask) * 8) == 0;
+    }
+
     uint64_t getCurrentTime() {
         struct timeval val{};
         gettimeofday(&val, nullptr);
@@ -73,6 +159,19 @@ namespace luwu {
         return ss.str();
     }
 
+    std::string backtraceToString(void *const *frames, int size, int skip, const std::string &prefix) {
+        std::stringstream ss;
+        char **strings = ::backtrace_symbols(frames, size);
+        if (strings == nullptr) {
+            return ss.str();
+        }
+        for (int i = skip; i < size; ++i) {
+            ss << prefix << " " << strings[i] << std::endl;
+        }
+        ::free(strings);
+        return ss.str();
+    }
+
     std::string formatTime(time_t ts, const std::string &format) {
         struct tm tm{};
         localtime_r(&ts, &tm);
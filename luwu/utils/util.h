@@ -5,6 +5,7 @@
 #ifndef LUWU_UTIL_H
 #define LUWU_UTIL_H
 
+#include <ctime>
 #include <cstdint>
 #include <vector>
 #include <string>
@@ -14,6 +15,7 @@ namespace luwu {
     /**
      * @brief 获得当前线程的线程 id
      * @return 线程 id
+     * @details 结果缓存在线程局部变量中，只有第一次调用会进行系统调用
      */
     uint32_t getThreadId();
 
@@ -29,6 +31,12 @@ namespace luwu {
      */
     uint64_t getElapseMs();
 
+    /**
+     * @brief 获得系统从开始运行到现在过去的时间，单位微秒
+     * @return 时间
+     */
+    uint64_t getElapseUs();
+
     /**
      * @brief 获得当前线程的线程名
      * @return 线程名
@@ -41,6 +49,34 @@ namespace luwu {
      */
     void setThreadName(const std::string &name);
 
+    /**
+     * @brief 获得系统中在线的 NUMA 节点
+     * @return 节点编号，从小到大排列，编号不一定连续（例如 "0,2"），系统不支持 NUMA 时为 {0}
+     */
+    std::vector<int> getNumaNodes();
+
+    /**
+     * @brief 获得 NUMA 节点上的所有 CPU
+     * @param node 节点编号
+     * @return CPU 编号，系统不支持 NUMA 时节点 0 包含所有 CPU
+     */
+    std::vector<int> getNumaNodeCpus(int node);
+
+    /**
+     * @brief 把当前线程绑定到一组 CPU 上运行
+     * @param cpus CPU 编号
+     * @return 是否成功
+     */
+    bool setThreadAffinity(const std::vector<int> &cpus);
+
+    /**
+     * @brief 当前线程之后分配的内存优先放在指定的 NUMA 节点上
+     * @param node 节点编号
+     * @return 是否成功
+     * @details 只影响之后第一次访问时才分配物理页的内存，例如新 mmap 的协程栈、新分配的缓冲区
+     */
+    bool setThreadNumaNode(int node);
+
     /**
      * @brief 获取当前时间
      * @return 系统当前时间
@@ -64,6 +100,16 @@ namespace luwu {
      */
     std::string backtraceToString(int size, int skip, const std::string &prefix = "");
 
+    /**
+     * @brief 将已经采集到的调用栈格式化为字符串，用于格式化其他时刻（例如信号处理函数中）采集的调用栈
+     * @param frames ::backtrace 采集到的返回地址
+     * @param size 返回地址数量
+     * @param skip 忽略前 skip 层信息
+     * @param prefix 前缀信息
+     * @return 字符串
+     */
+    std::string backtraceToString(void *const *frames, int size, int skip, const std::string &prefix = "");
+
     /**
      * @brief 格式化时间表示
      * @param ts time_t 类型的时间
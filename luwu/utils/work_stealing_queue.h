@@ -0,0 +1,165 @@
+//
+// Created by liucxi on 2022/12/11.
+//
+
+#ifndef LUWU_WORK_STEALING_QUEUE_H
+#define LUWU_WORK_STEALING_QUEUE_H
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "noncopyable.h"
+
+namespace luwu {
+    /**
+     * @brief Chase-Lev 无锁工作窃取双端队列
+     * @tparam T 元素类型，只能是指针，空指针表示没有取到元素
+     * @details 只有所属线程可以在底部 push/pop（后进先出，缓存友好），其他线程只能从顶部 steal（先进先出）。
+     * 容量不够时所属线程把数组扩大一倍，旧数组可能仍被正在 steal 的线程读取，所以保留到队列析构时才释放。
+     * 实现参考 Lê et al. "Correct and Efficient Work-Stealing for Weak Memory Models"
+     */
+    template<typename T>
+    class WorkStealingQueue : NonCopyable {
+    public:
+        /**
+         * @brief 构造函数
+         * @param capacity 初始容量，会向上取整为 2 的幂
+         */
+        explicit WorkStealingQueue(size_t capacity = 256) : top_(0), bottom_(0) {
+            size_t size = 1;
+            while (size < capacity) {
+                size <<= 1;
+            }
+            array_.store(new Array(size), std::memory_order_relaxed);
+        }
+
+        ~WorkStealingQueue() {
+            delete array_.load(std::memory_order_relaxed);
+            for (auto array : retired_) {
+                delete array;
+            }
+        }
+
+        /**
+         * @brief 在底部放入一个元素，只能由所属线程调用
+         * @param item 元素
+         */
+        void push(T item) {
+            int64_t b = bottom_.load(std::memory_order_relaxed);
+            int64_t t = top_.load(std::memory_order_acquire);
+            Array *array = array_.load(std::memory_order_relaxed);
+            if (b - t > static_cast<int64_t>(array->mask_)) {
+                array = grow(array, t, b);
+            }
+            array->put(b, item);
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief 从底部取出一个元素，只能由所属线程调用
+         * @return 元素，队列为空时返回 nullptr
+         */
+        T pop() {
+            int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+            Array *array = array_.load(std::memory_order_relaxed);
+            bottom_.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = top_.load(std::memory_order_relaxed);
+
+            if (t > b) {                    // 队列为空
+                bottom_.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            T item = array->get(b);
+            if (t == b) {
+                // 只剩最后一个元素，与 steal 竞争
+                if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    item = nullptr;
+                }
+                bottom_.store(b + 1, std::memory_order_relaxed);
+            }
+            return item;
+        }
+
+        /**
+         * @brief 从顶部窃取一个元素，任意线程都可以调用
+         * @return 元素，队列为空或者与其他线程竞争失败时返回 nullptr
+         */
+        T steal() {
+            int64_t t = top_.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t b = bottom_.load(std::memory_order_acquire);
+            if (t >= b) {
+                return nullptr;
+            }
+            Array *array = array_.load(std::memory_order_acquire);
+            T item = array->get(t);
+            if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return nullptr;
+            }
+            return item;
+        }
+
+        /**
+         * @brief 队列中元素的近似数量，其他线程调用时只能作为参考
+         */
+        size_t size() const {
+            int64_t b = bottom_.load(std::memory_order_relaxed);
+            int64_t t = top_.load(std::memory_order_relaxed);
+            return b > t ? static_cast<size_t>(b - t) : 0;
+        }
+
+        bool empty() const {
+            return size() == 0;
+        }
+
+    private:
+        /**
+         * @brief 环形数组，下标对容量取模
+         */
+        struct Array {
+            explicit Array(size_t size) : mask_(size - 1), buffer_(new std::atomic<T>[size]) {}
+
+            ~Array() {
+                delete[] buffer_;
+            }
+
+            T get(int64_t index) const {
+                return buffer_[index & mask_].load(std::memory_order_relaxed);
+            }
+
+            void put(int64_t index, T item) {
+                buffer_[index & mask_].store(item, std::memory_order_relaxed);
+            }
+
+            size_t mask_;
+            std::atomic<T> *buffer_;
+        };
+
+        Array *grow(Array *array, int64_t t, int64_t b) {
+            auto *bigger = new Array((array->mask_ + 1) << 1);
+            for (int64_t i = t; i < b; ++i) {
+                bigger->put(i, array->get(i));
+            }
+            retired_.push_back(array);
+            array_.store(bigger, std::memory_order_release);
+            return bigger;
+        }
+
+    private:
+        /// 顶部下标，steal 的位置
+        std::atomic<int64_t> top_;
+        /// top_ 与 bottom_ 分别由窃取线程和所属线程频繁修改，放在不同的缓存行上
+        char padding_[64 - sizeof(std::atomic<int64_t>)];
+        /// 底部下标，push/pop 的位置
+        std::atomic<int64_t> bottom_;
+        /// 当前使用的数组
+        std::atomic<Array *> array_;
+        /// 扩容后被替换下来的数组，只有所属线程会修改
+        std::vector<Array *> retired_;
+    };
+}
+
+#endif //LUWU_WORK_STEALING_QUEUE_H
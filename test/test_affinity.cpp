@@ -0,0 +1,63 @@
+//
+// Created by liucxi on 2022/12/13.
+//
+
+#include <sched.h>
+#include <iostream>
+#include "scheduler.h"
+#include "utils/util.h"
+#include "utils/mutex.h"
+
+using namespace luwu;
+
+static Mutex s_mutex;
+
+// 打印当前线程所在的 CPU 和允许运行的 CPU
+void show_placement() {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    sched_getaffinity(0, sizeof set, &set);
+    Mutex::Lock lock(s_mutex);
+    std::cout << getThreadName() << " tid = " << getThreadId() << ", on cpu " << sched_getcpu() << ", allowed:";
+    for (int i = 0; i < CPU_SETSIZE; ++i) {
+        if (CPU_ISSET(i, &set)) {
+            std::cout << " " << i;
+        }
+    }
+    std::cout << std::endl;
+}
+
+int main() {
+    std::vector<int> nodes = getNumaNodes();
+    std::cout << "numa nodes: " << nodes.size() << std::endl;
+    for (int node : nodes) {
+        std::cout << "node " << node << " cpus:";
+        for (int cpu : getNumaNodeCpus(node)) {
+            std::cout << " " << cpu;
+        }
+        std::cout << std::endl;
+    }
+
+    // 每个子线程绑定一个 CPU
+    {
+        Scheduler scheduler("cpu", 2, false);
+        scheduler.setCpuAffinity(getNumaNodeCpus(0));
+        scheduler.start();
+        for (int i = 0; i < 4; ++i) {
+            scheduler.addTask(show_placement);
+        }
+        scheduler.stop();
+    }
+
+    // 子线程轮流分配到各个 NUMA 节点，只在本节点的 CPU 上运行，内存也从本节点分配
+    {
+        Scheduler scheduler("numa", 2, false);
+        scheduler.setNumaNode(Scheduler::NUMA_SPREAD);
+        scheduler.start();
+        for (int i = 0; i < 4; ++i) {
+            scheduler.addTask(show_placement);
+        }
+        scheduler.stop();
+    }
+    return 0;
+}
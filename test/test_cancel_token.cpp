@@ -0,0 +1,85 @@
+//
+// Created by liucxi on 2022/12/10.
+//
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <iostream>
+#include <cstring>
+#include "reactor.h"
+#include "cancel_token.h"
+#include "utils/util.h"
+
+using namespace luwu;
+
+static int listen_on_loopback(sockaddr_in &addr) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = 0;
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr.s_addr);
+    bind(fd, (const sockaddr *) &addr, sizeof addr);
+    listen(fd, 16);
+    socklen_t len = sizeof addr;
+    getsockname(fd, (sockaddr *) &addr, &len);
+    return fd;
+}
+
+void test_cancel() {
+    sockaddr_in addr{};
+    int listen_fd = listen_on_loopback(addr);
+
+    // 1. 截止时间到期，accept 返回 ETIMEDOUT
+    {
+        CancelToken::Guard guard(CancelToken::Create(200));
+        uint64_t start = getCurrentTime();
+        int rt = accept(listen_fd, nullptr, nullptr);
+        std::cout << "accept rt = " << rt << ", err = " << strerror(errno)
+                  << ", cost " << getCurrentTime() - start << " ms, expect ~200" << std::endl;
+    }
+
+    int client = socket(AF_INET, SOCK_STREAM, 0);
+    int rt = connect(client, (const sockaddr *) &addr, sizeof addr);
+    std::cout << "connect rt = " << rt << std::endl;
+    int server = accept(listen_fd, nullptr, nullptr);
+
+    // 2. 令牌被其他协程取消，阻塞在 recv 上的协程立即返回 ECANCELED
+    {
+        auto token = CancelToken::Create();
+        Reactor::GetThis()->addClock(100, [token]() {
+            token->cancel();
+        });
+        CancelToken::Guard guard(token);
+        char buffer[16];
+        uint64_t start = getCurrentTime();
+        ssize_t n = recv(server, buffer, sizeof buffer, 0);
+        std::cout << "recv rt = " << n << ", err = " << strerror(errno)
+                  << ", cost " << getCurrentTime() - start << " ms, expect ~100" << std::endl;
+    }
+
+    // 3. 子令牌的截止时间不晚于父令牌，父令牌取消时子令牌一起取消
+    {
+        auto parent = CancelToken::Create(300);
+        auto child = CancelToken::Create(1000, parent);
+        std::cout << "child remaining <= 300: " << (child->getRemaining() <= 300) << std::endl;
+        parent->cancel();
+        std::cout << "child error = " << strerror(child->getError()) << std::endl;
+    }
+
+    // 4. 没有绑定令牌时不受影响
+    send(client, "ping", 4, 0);
+    char buffer[16] = {0};
+    ssize_t n = recv(server, buffer, sizeof buffer, 0);
+    std::cout << "recv without token rt = " << n << ", data = " << buffer << std::endl;
+
+    close(client);
+    close(server);
+    close(listen_fd);
+}
+
+int main() {
+    Reactor r("cancel");
+    r.addTask(test_cancel);
+    return 0;
+}
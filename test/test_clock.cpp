@@ -3,8 +3,10 @@
 //
 
 #include "clock.h"
+#include <atomic>
 #include <iostream>
 #include "reactor.h"
+#include "utils/util.h"
 
 using namespace luwu;
 
@@ -21,7 +23,37 @@ void timer_callback() {
     }
 }
 
+// 周期 10 毫秒、每次执行 30 毫秒的周期定时器，回调带有可变状态，同一个定时器的回调不能同时执行
+void test_slow_recurring() {
+    static std::atomic<int> running{0};
+    static std::atomic<int> overlapped{0};
+    static std::atomic<int> runs{0};
+    static Clock::ptr slow_clock;
+    {
+        Reactor reactor("slow_clock", 2, false);
+        int count = 0;
+        slow_clock = reactor.addClock(10, [count]() mutable {
+            if (++running > 1) {
+                ++overlapped;
+            }
+            ++count;
+            uint64_t begin = getElapseMs();
+            while (getElapseMs() - begin < 30) {
+            }
+            --running;
+            if (count == 10) {
+                slow_clock->cancel();
+            }
+            ++runs;
+        }, true);
+    }
+    std::cout << "slow recurring clock runs = " << runs << ", expect 10; overlapped = " << overlapped
+              << ", expect 0" << std::endl;
+}
+
 int main() {
+    test_slow_recurring();
+
     Reactor r("reactor");
     // 循环定时器
     s_clock = r.addClock(1000, timer_callback, true);
@@ -0,0 +1,70 @@
+//
+// Created by liucxi on 2022/12/2.
+//
+
+#include <ucontext.h>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include "fiber.h"
+
+using namespace luwu;
+
+static const int s_rounds = 1000000;
+
+// 直接使用 swapcontext 的对照组
+static ucontext_t s_main_ctx;
+static ucontext_t s_func_ctx;
+
+void run_in_ucontext() {
+    while (true) {
+        swapcontext(&s_func_ctx, &s_main_ctx);
+    }
+}
+
+void bench_ucontext() {
+    static char stack[128 * 1024];
+    getcontext(&s_func_ctx);
+    s_func_ctx.uc_link = nullptr;
+    s_func_ctx.uc_stack.ss_sp = stack;
+    s_func_ctx.uc_stack.ss_size = sizeof stack;
+    makecontext(&s_func_ctx, run_in_ucontext, 0);
+
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < s_rounds; ++i) {
+        swapcontext(&s_main_ctx, &s_func_ctx);
+    }
+    auto end = std::chrono::steady_clock::now();
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+    std::cout << "raw swapcontext: " << static_cast<double>(ns) / (s_rounds * 2) << " ns/switch" << std::endl;
+}
+
+void run_in_fiber() {
+    for (int i = 0; i < s_rounds; ++i) {
+        Fiber::GetThis()->yield();
+    }
+}
+
+void bench_fiber() {
+    Fiber::InitMainFiber();
+    Fiber::ptr fiber(new Fiber(run_in_fiber, false));
+
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < s_rounds; ++i) {
+        fiber->resume();
+    }
+    auto end = std::chrono::steady_clock::now();
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+    std::cout << "fiber (" << Context::Backend() << "): "
+              << static_cast<double>(ns) / (s_rounds * 2) << " ns/switch" << std::endl;
+
+    fiber->resume();            // 让协程函数执行结束
+}
+
+int main() {
+    std::thread t1(bench_ucontext);
+    t1.join();
+    std::thread t2(bench_fiber);
+    t2.join();
+    return 0;
+}
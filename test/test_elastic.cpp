@@ -0,0 +1,88 @@
+//
+// Created by liucxi on 2022/12/17.
+//
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <thread>
+#include "reactor.h"
+#include "utils/util.h"
+
+using namespace luwu;
+
+static std::atomic<uint32_t> s_max_threads{0};
+static std::mutex s_mutex;
+static std::set<uint32_t> s_tids;
+
+// 不经过 hook 的阻塞调用，协程无法让出，所在线程被占住
+void blocking_task(Scheduler *scheduler) {
+    uint32_t num = scheduler->getThreadNum();
+    uint32_t max = s_max_threads;
+    while (num > max && !s_max_threads.compare_exchange_weak(max, num)) {
+    }
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_tids.insert(getThreadId());
+    }
+    uint64_t begin = getElapseMs();
+    while (getElapseMs() - begin < 100) {
+    }
+}
+
+// 提交 16 个各占住线程 100 毫秒的任务，观察线程数量的增加和空闲后的减少
+void test(Scheduler &scheduler, const std::string &name, uint32_t idle_wait) {
+    s_max_threads = 0;
+    s_tids.clear();
+    auto begin = std::chrono::steady_clock::now();
+    std::atomic<int> done{0};
+    for (int i = 0; i < 16; ++i) {
+        scheduler.addTask([&scheduler, &done]() {
+            blocking_task(&scheduler);
+            ++done;
+        });
+    }
+    while (done < 16) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::cout << name << ": 16 blocking tasks of 100 ms in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count()
+              << " ms, expect far less than 1600; peak threads = " << s_max_threads << ", expect 4" << std::endl;
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(idle_wait));
+    std::cout << name << ": threads after idle = " << scheduler.getThreadNum() << ", expect 1" << std::endl;
+
+    // 指定给已经退出的线程的任务改为不指定线程调度，仍然会执行，调度器也能正常停止
+    static std::atomic<int> pinned;
+    pinned = 0;
+    for (uint32_t tid : s_tids) {
+        scheduler.addTask([]() {
+            ++pinned;
+        }, tid);
+    }
+    uint64_t wait_begin = getElapseMs();
+    while (pinned < static_cast<int>(s_tids.size()) && getElapseMs() - wait_begin < 1000) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::cout << name << ": tasks pinned to exited threads run = " << pinned << "/" << s_tids.size() << std::endl;
+}
+
+int main() {
+    {
+        Scheduler scheduler("elastic", 1, false);
+        // 1 到 4 个子线程，排队超过 10 毫秒就扩容，空闲 200 毫秒就缩容
+        scheduler.setElastic(1, 4, 10, 200);
+        scheduler.start();
+        test(scheduler, "scheduler", 1000);
+        scheduler.stop();
+    }
+    {
+        // 反应堆空闲线程阻塞在 epoll_wait 中，最长 3 秒醒来一次检查是否空闲太久
+        Reactor reactor("elastic_io", 1, 4, false, 10, 200);
+        test(reactor, "reactor", 4000);
+    }
+    return 0;
+}
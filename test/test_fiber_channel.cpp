@@ -0,0 +1,91 @@
+//
+// Created by liucxi on 2022/12/8.
+//
+
+#include <iostream>
+#include <string>
+#include "fiber_channel.h"
+#include "scheduler.h"
+#include "utils/util.h"
+
+using namespace luwu;
+
+static FiberChannel<int> s_bounded(4);
+static FiberChannel<int> s_unbuffered;
+static FiberChannel<std::string> s_names(FiberChannel<std::string>::UNBOUNDED);
+static std::atomic<long> s_sum{0};
+
+// 多个生产者、多个消费者，缓冲区满或空时挂起的是协程而不是线程
+void test_producer(int base) {
+    for (int i = 0; i < 1000; ++i) {
+        s_bounded.send(base + i);
+    }
+}
+
+void test_consumer() {
+    int value;
+    while (s_bounded.recv(value)) {
+        s_sum += value;
+    }
+}
+
+void test_select() {
+    int done = 0;
+    while (done < 2) {
+        FiberSelect().recv(s_unbuffered, [&done](int value, bool ok) {
+            if (!ok) {
+                ++done;
+                return;
+            }
+            std::cout << getThreadId() << ", " << Fiber::GetFiberId() << " select unbuffered " << value << std::endl;
+        }).recv(s_names, [&done](std::string name, bool ok) {
+            if (!ok) {
+                ++done;
+                return;
+            }
+            std::cout << getThreadId() << ", " << Fiber::GetFiberId() << " select names " << name << std::endl;
+        }).wait();
+    }
+}
+
+void test_select_sender() {
+    for (int i = 0; i < 3; ++i) {
+        s_unbuffered.send(i);
+        s_names.send("fiber_" + std::to_string(i));
+    }
+    int value = 100;
+    std::cout << "trySend on unbuffered without receiver: " << s_unbuffered.trySend(value) << std::endl;
+    s_unbuffered.close();
+    s_names.close();
+}
+
+int main() {
+    {
+        Scheduler scheduler("channel", 3, false);
+        scheduler.start();
+        for (int i = 0; i < 4; ++i) {
+            scheduler.addTask(test_consumer);
+        }
+        for (int i = 0; i < 4; ++i) {
+            scheduler.addTask(std::bind(test_producer, i * 1000));
+        }
+        // 等待所有数据被取完之后关闭，消费者的 recv 返回 false
+        scheduler.addTask([]() {
+            while (s_sum < 7998000) {
+                Scheduler::GetThis()->addTask(Fiber::GetThis());
+                Fiber::GetThis()->yield();
+            }
+            s_bounded.close();
+        });
+        scheduler.stop();
+        std::cout << "sum = " << s_sum << ", expect 7998000" << std::endl;
+    }
+    {
+        Scheduler scheduler("select", 2, false);
+        scheduler.start();
+        scheduler.addTask(test_select);
+        scheduler.addTask(test_select_sender);
+        scheduler.stop();
+    }
+    return 0;
+}
@@ -0,0 +1,68 @@
+//
+// Created by liucxi on 2022/12/8.
+//
+
+#include <iostream>
+#include <vector>
+#include "fiber_future.h"
+#include "scheduler.h"
+#include "utils/util.h"
+
+using namespace luwu;
+
+// 模拟一次后端调用，中途 yield 若干次
+int backend_call(int i) {
+    for (int j = 0; j < i % 5; ++j) {
+        Scheduler::GetThis()->addTask(Fiber::GetThis());
+        Fiber::GetThis()->yield();
+    }
+    return i * i;
+}
+
+// 把 N 个子任务分发到调度器，用 Future 收集结果
+void test_future() {
+    std::vector<Future<int>> futures;
+    for (int i = 0; i < 20; ++i) {
+        Promise<int> promise;
+        futures.push_back(promise.getFuture());
+        Scheduler::GetThis()->addTask([promise, i]() {
+            promise.setValue(backend_call(i));
+        });
+    }
+    int sum = 0;
+    for (auto &future : futures) {
+        sum += future.get();
+    }
+    std::cout << getThreadId() << ", " << Fiber::GetFiberId() << " future sum = " << sum << ", expect 2470" << std::endl;
+
+    Promise<void> done;
+    Scheduler::GetThis()->addTask([done]() {
+        done.setValue();
+    });
+    done.getFuture().get();
+    std::cout << "void future done" << std::endl;
+}
+
+// 用 WaitGroup 等待一组子任务结束
+void test_wait_group() {
+    WaitGroup wg;
+    std::atomic<int> sum{0};
+    for (int i = 0; i < 20; ++i) {
+        wg.add();
+        Scheduler::GetThis()->addTask([&wg, &sum, i]() {
+            sum += backend_call(i);
+            wg.done();
+        });
+    }
+    wg.wait();
+    std::cout << getThreadId() << ", " << Fiber::GetFiberId() << " wait group sum = " << sum << ", expect 2470" << std::endl;
+}
+
+int main() {
+    Scheduler scheduler("future", 3, false);
+    scheduler.start();
+    scheduler.addTask(test_future);
+    scheduler.addTask(test_wait_group);
+    scheduler.stop();
+    return 0;
+}
@@ -0,0 +1,47 @@
+//
+// Created by liucxi on 2022/12/6.
+//
+
+#include <iostream>
+#include "fiber_local.h"
+#include "scheduler.h"
+#include "utils/util.h"
+
+using namespace luwu;
+
+static FiberLocal<int> s_request_id;
+static FiberLocal<std::string> s_trace;
+
+void handle_request(int id) {
+    s_request_id.set(id);
+    s_trace->append("begin ");
+
+    // 让出执行权，再次恢复时可能在另一个线程上，协程局部变量跟随协程
+    Scheduler::GetThis()->addTask(Fiber::GetThis());
+    Fiber::GetThis()->yield();
+
+    s_trace->append("end");
+    std::cout << getThreadId() << ", " << Fiber::GetFiberId() << " request id = " << *s_request_id
+              << ", trace = " << *s_trace << ", expect id = " << id << std::endl;
+}
+
+int main() {
+    Scheduler scheduler("scheduler", 2, false);
+    scheduler.start();
+    for (int i = 0; i < 10; ++i) {
+        scheduler.addTask(std::bind(handle_request, i));
+    }
+    scheduler.stop();
+
+    // 内联任务设置的值在任务返回后被清除，同一线程上之后的内联任务看不到
+    Scheduler inline_scheduler("inline", 1, false);
+    inline_scheduler.start();
+    inline_scheduler.addInlineTask([]() {
+        s_request_id.set(42);
+    });
+    inline_scheduler.addInlineTask([]() {
+        std::cout << "inline task sees a leaked value = " << s_request_id.has() << ", expect 0" << std::endl;
+    });
+    inline_scheduler.stop();
+    return 0;
+}
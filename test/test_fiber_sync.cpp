@@ -0,0 +1,74 @@
+//
+// Created by liucxi on 2022/12/7.
+//
+
+#include <iostream>
+#include "fiber_sync.h"
+#include "scheduler.h"
+#include "utils/util.h"
+
+using namespace luwu;
+
+static FiberMutex s_mutex;
+static FiberCondVar s_cond;
+static FiberSemaphore s_sem(2);
+static int s_count = 0;
+static bool s_ready = false;
+
+// 持有锁期间 yield，其他协程加锁时挂起的是协程而不是线程
+void test_mutex() {
+    for (int i = 0; i < 100; ++i) {
+        FiberMutex::Lock lock(s_mutex);
+        int count = s_count;
+        Scheduler::GetThis()->addTask(Fiber::GetThis());
+        Fiber::GetThis()->yield();
+        s_count = count + 1;
+    }
+}
+
+void test_cond_wait() {
+    FiberMutex::Lock lock(s_mutex);
+    while (!s_ready) {
+        s_cond.wait(s_mutex);
+    }
+    std::cout << getThreadId() << ", " << Fiber::GetFiberId() << " cond wait done" << std::endl;
+}
+
+void test_cond_notify() {
+    FiberMutex::Lock lock(s_mutex);
+    s_ready = true;
+    s_cond.notifyAll();
+}
+
+void test_semaphore(int i) {
+    s_sem.wait();
+    std::cout << getThreadId() << ", " << Fiber::GetFiberId() << " semaphore acquired, i = " << i << std::endl;
+    Scheduler::GetThis()->addTask(Fiber::GetThis());
+    Fiber::GetThis()->yield();
+    s_sem.notify();
+}
+
+int main() {
+    {
+        Scheduler scheduler("mutex", 3, false);
+        scheduler.start();
+        for (int i = 0; i < 8; ++i) {
+            scheduler.addTask(test_mutex);
+        }
+        scheduler.stop();
+        std::cout << "count = " << s_count << ", expect 800" << std::endl;
+    }
+    {
+        Scheduler scheduler("cond", 2, false);
+        scheduler.start();
+        for (int i = 0; i < 4; ++i) {
+            scheduler.addTask(test_cond_wait);
+        }
+        scheduler.addTask(test_cond_notify);
+        for (int i = 0; i < 6; ++i) {
+            scheduler.addTask(std::bind(test_semaphore, i));
+        }
+        scheduler.stop();
+    }
+    return 0;
+}
@@ -0,0 +1,198 @@
+//
+// Created by liucxi on 2022/12/15.
+//
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include "fiber.h"
+#include "scheduler.h"
+#include "utils/util.h"
+
+using namespace luwu;
+
+static bool s_failed = false;
+
+static void check(bool ok, const std::string &name) {
+    std::cout << (ok ? "PASS " : "FAIL ") << name << std::endl;
+    s_failed |= !ok;
+}
+
+// 协程在运行中唤醒自己：状态变为 NOTIFIED，yield 之后 resume 返回 true，协程回到 READY
+static void test_wake_running() {
+    Fiber::InitMainFiber();
+    Fiber *self = nullptr;
+    bool woken = true;
+    Fiber::ptr fiber(new Fiber([&self, &woken]() {
+        woken = self->wake();
+        self->yield();
+    }, false));
+    self = fiber.get();
+    bool notified = fiber->resume();
+    check(!woken && notified && fiber->getState() == Fiber::READY, "wake while RUNNING is handed to resume");
+    notified = fiber->resume();
+    check(!notified && fiber->getState() == Fiber::TERM, "fiber finishes after the handed wake");
+}
+
+// 另一个线程在协程运行、正在 yield、已经切换出去时唤醒它，每次唤醒恰好让协程多运行一轮，不会丢失也不会重复
+static void test_wake_race() {
+    static const uint64_t rounds_target = 100000;
+    std::atomic<uint64_t> rounds{0};
+    std::atomic<bool> handed{false};
+    std::atomic<bool> stop{false};
+    std::atomic<bool> waker_done{false};
+    bool lost = false;
+    uint64_t running_hits = 0;
+    uint64_t suspending_hits = 0;
+    uint64_t suspended_hits = 0;
+    Fiber::ptr fiber;
+
+    std::thread owner([&]() {
+        Fiber::InitMainFiber();
+        Fiber *self = nullptr;
+        fiber.reset(new Fiber([&self, &rounds, &stop]() {
+            while (!stop) {
+                ++rounds;
+                // 运行时间长短不一，唤醒落在不同的状态上
+                for (volatile uint64_t i = 0; i < rounds % 64 * 4; ++i) {
+                }
+                self->yield();
+            }
+        }, false));
+        self = fiber.get();
+        uint64_t begin = getElapseMs();
+        while (!stop) {
+            if (fiber->resume()) {
+                continue;
+            }
+            // 已经切换出去，等待唤醒者把它交回来，1 秒没有交回来就是唤醒丢了
+            uint64_t wait_begin = getElapseMs();
+            while (!handed.exchange(false) && !stop) {
+                if (getElapseMs() - wait_begin > 1000) {
+                    lost = true;
+                    stop = true;
+                }
+                std::this_thread::yield();
+            }
+            if (rounds >= rounds_target || getElapseMs() - begin > 3000) {
+                stop = true;
+            }
+        }
+        // 唤醒者退出之后协程停在 SUSPENDED 或者 READY，再恢复一次让它看到 stop 结束
+        while (!waker_done) {
+            std::this_thread::yield();
+        }
+        fiber->resume();
+    });
+
+    std::thread waker([&]() {
+        uint64_t seen = 0;
+        while (!stop) {
+            if (rounds == seen) {
+                std::this_thread::yield();
+                continue;
+            }
+            seen = rounds;
+            Fiber::State state = fiber->getState();
+            if (fiber->wake()) {
+                ++suspended_hits;
+                handed = true;
+            } else if (state == Fiber::RUNNING) {
+                ++running_hits;
+            } else if (state == Fiber::SUSPENDING) {
+                // 看到 SUSPENDING 之后只有唤醒才能让它离开 SUSPENDED，wake 返回 false 说明唤醒落在了 SUSPENDING 上
+                ++suspending_hits;
+            }
+        }
+        waker_done = true;
+    });
+    owner.join();
+    waker.join();
+    std::cout << rounds << " rounds, wakes while RUNNING = " << running_hits << ", SUSPENDING = "
+              << suspending_hits << ", SUSPENDED = " << suspended_hits << std::endl;
+    check(!lost && fiber->getState() == Fiber::TERM, "no wake lost or duplicated");
+    // 切换窗口只有几十纳秒，只有一个 CPU 时两个线程不会同时运行，只能靠抢占偶尔碰到
+    if (std::thread::hardware_concurrency() > 1) {
+        check(running_hits > 0, "wake raced a RUNNING fiber");
+        check(suspending_hits > 0, "wake raced a SUSPENDING fiber");
+    } else {
+        std::cout << "SKIP wake raced a RUNNING / SUSPENDING fiber, needs at least 2 cpus" << std::endl;
+    }
+}
+
+// 协程指定线程唤醒自己再 yield，唤醒落在 RUNNING 上，重新调度时仍然要去指定的线程
+static void test_pinned_requeue() {
+    Scheduler scheduler("wake", 2, false);
+    scheduler.start();
+    std::atomic<uint32_t> tids[2];
+    tids[0] = 0;
+    tids[1] = 0;
+    std::atomic<int> landed{0};
+    std::atomic<bool> done{false};
+    // 先找到两个调度线程的线程 id
+    while (!tids[1]) {
+        scheduler.addTask([&tids]() {
+            uint32_t tid = getThreadId();
+            uint32_t expect = 0;
+            if (!tids[0].compare_exchange_strong(expect, tid) && expect != tid) {
+                expect = 0;
+                tids[1].compare_exchange_strong(expect, tid);
+            }
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    scheduler.addTask([&]() {
+        for (int i = 0; i < 20; ++i) {
+            uint32_t target = getThreadId() == tids[0] ? tids[1] : tids[0];
+            scheduler.addTask(Fiber::GetThis(), target);
+            Fiber::GetThis()->yield();
+            landed += getThreadId() == target ? 1 : 0;
+        }
+        done = true;
+    });
+    while (!done) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    scheduler.stop();
+    std::cout << "landed on the requested thread " << landed << "/20" << std::endl;
+    check(landed == 20, "pinned wake of a RUNNING fiber keeps its thread");
+}
+
+// 协程 yield 之后被外部线程连续唤醒两次：第二次唤醒被合并，协程只被放入队列、恢复一次
+static void test_double_wake() {
+    Scheduler scheduler("double", 2, false);
+    scheduler.start();
+    std::atomic<Fiber *> parked{nullptr};
+    std::atomic<int> resumed{0};
+    std::atomic<bool> done{false};
+    Fiber::ptr fiber;
+    scheduler.addTask([&]() {
+        fiber = Fiber::GetThis();
+        parked = fiber.get();
+        Fiber::GetThis()->yield();
+        ++resumed;
+        done = true;
+    });
+    // 等协程完全切换出去之后再唤醒，两次唤醒都落在 SUSPENDED 之后
+    while (!parked || parked.load()->getState() != Fiber::SUSPENDED) {
+        std::this_thread::yield();
+    }
+    scheduler.addTask(fiber);
+    scheduler.addTask(fiber);
+    while (!done) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    bool finished = fiber->getState() == Fiber::TERM;
+    scheduler.stop();
+    check(resumed == 1 && finished, "double wake of a SUSPENDED fiber resumes it once");
+    check(!fiber->wake(), "wake of a finished fiber is ignored");
+}
+
+int main() {
+    test_wake_running();
+    test_wake_race();
+    test_pinned_requeue();
+    test_double_wake();
+    return s_failed ? 1 : 0;
+}
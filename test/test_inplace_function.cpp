@@ -0,0 +1,105 @@
+//
+// Created by liucxi on 2022/12/16.
+//
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <thread>
+#include "reactor.h"
+#include "utils/inplace_function.h"
+
+using namespace luwu;
+
+static std::atomic<uint64_t> s_allocs{0};
+
+void *operator new(size_t size) {
+    ++s_allocs;
+    void *p = malloc(size);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+struct Client {
+    void handle(const std::shared_ptr<int> &fd) {
+        sum_ += *fd;
+    }
+
+    int sum_ = 0;
+};
+
+// 与 TCPServer 派发连接相同的绑定：成员函数指针加两个智能指针
+static void test_bind() {
+    auto client = std::make_shared<Client>();
+    auto fd = std::make_shared<int>(3);
+    uint64_t before = s_allocs;
+    task_func f(std::bind(&Client::handle, client, fd));
+    task_func g(std::move(f));
+    g();
+    std::cout << "bind: sum = " << client->sum_ << ", allocations = " << s_allocs - before
+              << ", moved-from empty = " << (f == nullptr) << std::endl;
+}
+
+// 只能移动的捕获，std::function 放不下
+static void test_move_only() {
+    std::unique_ptr<int> value(new int(42));
+    struct Holder {
+        std::unique_ptr<int> value_;
+
+        void operator()() const {
+            std::cout << "move only: value = " << *value_ << std::endl;
+        }
+    };
+    task_func f(Holder{std::move(value)});
+    f();
+}
+
+// 超过容量时退回到堆上，行为不变
+static void test_heap_fallback() {
+    char big[128] = "heap fallback";
+    uint64_t before = s_allocs;
+    task_func f([big]() {
+        std::cout << big;
+    });
+    f();
+    std::cout << ", allocations = " << s_allocs - before << std::endl;
+}
+
+// 周期定时器每次触发都执行同一个回调，条件定时器在条件失效后不再执行
+static void test_clock() {
+    std::atomic<int> ticks{0};
+    std::atomic<int> cond_runs{0};
+    {
+        Reactor reactor("clock", 1, false);
+        Clock::ptr clock = reactor.addClock(10, [&ticks]() {
+            ++ticks;
+        }, true);
+        auto cond = std::make_shared<int>(0);
+        reactor.addCondClock(20, [&cond_runs]() {
+            ++cond_runs;
+        }, cond);
+        reactor.addCondClock(20, [&cond_runs]() {
+            ++cond_runs;
+        }, std::weak_ptr<int>());
+        std::this_thread::sleep_for(std::chrono::milliseconds(105));
+        clock->cancel();
+    }
+    std::cout << "recurring ticks = " << ticks << ", expect about 10; cond runs = " << cond_runs
+              << ", expect 1" << std::endl;
+}
+
+int main() {
+    test_bind();
+    test_move_only();
+    test_heap_fallback();
+    test_clock();
+    return 0;
+}
@@ -0,0 +1,69 @@
+//
+// Created by liucxi on 2022/12/20.
+//
+
+#include <atomic>
+#include <iostream>
+#include <unistd.h>
+#include "reactor.h"
+
+using namespace luwu;
+
+static std::atomic<int> s_done{0};
+
+void short_task() {
+    volatile uint64_t sum = 0;
+    for (int i = 0; i < 10000; ++i) {
+        sum += i;
+    }
+    ++s_done;
+}
+
+void print_histogram(const std::string &name, const Histogram::Snapshot &snapshot) {
+    std::cout << name << ": count = " << snapshot.count_ << ", mean = " << snapshot.mean()
+              << ", p50 = " << snapshot.percentile(0.5) << ", p99 = " << snapshot.percentile(0.99)
+              << ", max = " << snapshot.max_ << std::endl;
+}
+
+int main() {
+    Reactor reactor("metrics", 2, false);
+    // 开启看门狗才记录时间片长度
+    reactor.setWatchdog(100, false);
+    Reactor::Metrics before = reactor.getReactorMetrics();
+
+    // 外部线程分批提交任务，中间穿插定时器
+    std::atomic<int> fired{0};
+    for (int i = 0; i < 20; ++i) {
+        reactor.addClock(i, [&fired]() {
+            ++fired;
+        });
+    }
+    for (int round = 0; round < 10; ++round) {
+        for (int i = 0; i < 500; ++i) {
+            reactor.addTask(short_task);
+        }
+        std::cout << "queue depth after submit = " << reactor.getReactorMetrics().queue_depth_ << std::endl;
+        usleep(5 * 1000);
+    }
+    while (s_done < 5000 || fired < 20) {
+        usleep(1000);
+    }
+
+    Reactor::Metrics after = reactor.getReactorMetrics();
+    double seconds = static_cast<double>(after.time_us_ - before.time_us_) / 1000000;
+    std::cout << "resumes = " << after.resumes_ - before.resumes_ << ", expect at least 5020, "
+              << static_cast<uint64_t>(static_cast<double>(after.resumes_ - before.resumes_) / seconds)
+              << " per second; queue depth = " << after.queue_depth_ << ", expect 0" << std::endl;
+    print_histogram("wait us", after.waits_);
+    print_histogram("slice us", after.slices_);
+    print_histogram("events per wakeup", after.events_per_wakeup_);
+    std::cout << "timers fired = " << after.timers_fired_ << ", expect 20" << std::endl;
+    std::cout << "tickles = " << after.tickles_ << ", skipped = " << after.skipped_tickles_
+              << "; wakeups = " << after.wakeups_ << ", empty = " << after.empty_wakeups_ << std::endl;
+    for (auto &thread : after.threads_) {
+        std::cout << "thread " << thread.tid_ << ": resumes = " << thread.resumes_ << ", busy = "
+                  << thread.busy_us_ / 1000 << " ms, idle = " << thread.idle_us_ / 1000 << " ms, wakeups = "
+                  << thread.wakeups_ << ", empty = " << thread.empty_wakeups_ << std::endl;
+    }
+    return 0;
+}
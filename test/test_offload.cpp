@@ -0,0 +1,86 @@
+//
+// Created by liucxi on 2022/12/18.
+//
+
+#include <atomic>
+#include <iostream>
+#include <netdb.h>
+#include <unistd.h>
+#include "offload.h"
+#include "reactor.h"
+#include "utils/util.h"
+
+using namespace luwu;
+
+static std::atomic<int> s_ticks{0};
+static Clock::ptr s_ticker;
+
+void blocking_calls() {
+    uint32_t tid = getThreadId();
+    uint64_t begin = getElapseMs();
+
+    // 卸载线程没有 hook，这里的 usleep 真正阻塞的是卸载线程
+    int value = offload([]() {
+        usleep(200 * 1000);
+        return 42;
+    });
+    std::cout << "offload value = " << value << ", took " << getElapseMs() - begin
+              << " ms, ticks meanwhile = " << s_ticks << ", expect about 20" << std::endl;
+    std::cout << "resumed on origin scheduler: " << (Reactor::GetThis() != nullptr)
+              << ", same thread: " << (getThreadId() == tid) << std::endl;
+
+    int rt = offload([]() {
+        addrinfo hints{};
+        addrinfo *result = nullptr;
+        hints.ai_family = AF_INET;
+        int rt = getaddrinfo("localhost", nullptr, &hints, &result);
+        if (rt == 0) {
+            freeaddrinfo(result);
+        }
+        return rt;
+    });
+    std::cout << "getaddrinfo(localhost) rt = " << rt << std::endl;
+
+    // 线程池有界：2 个线程、最多排队 2 个，8 个任务分批执行，提交者在队列满时挂起
+    OffloadPool pool("bounded", 2, 2);
+    std::vector<Future<int>> futures;
+    begin = getElapseMs();
+    for (int i = 0; i < 8; ++i) {
+        futures.push_back(pool.submit([i]() {
+            usleep(50 * 1000);
+            return i;
+        }));
+    }
+    int sum = 0;
+    for (auto &future : futures) {
+        sum += future.get();
+    }
+    std::cout << "bounded pool sum = " << sum << ", expect 28, took " << getElapseMs() - begin
+              << " ms, expect about 200" << std::endl;
+    s_ticker->cancel();
+}
+
+int main() {
+    // 不在协程中时直接在当前线程执行
+    std::cout << "inline value = " << offload([]() {
+        return 7;
+    }) << std::endl;
+
+    {
+        Reactor reactor("offload", 1, false);
+        // 与卸载的阻塞调用同时运行，反应堆线程没有被占住时每 10 毫秒走一次
+        s_ticker = reactor.addClock(10, []() {
+            ++s_ticks;
+        }, true);
+        reactor.addTask(blocking_calls);
+    }
+
+    // 使用调用线程的反应堆析构之后，调用线程仍然开着 hook，但已经不在协程中，仍然直接执行
+    {
+        Reactor reactor("offload_caller", 1, true);
+    }
+    std::cout << "inline value after use_caller reactor = " << offload([]() {
+        return 7;
+    }) << std::endl;
+    return 0;
+}
@@ -0,0 +1,62 @@
+//
+// Created by liucxi on 2022/12/9.
+//
+
+#include <cmath>
+#include <iostream>
+#include <set>
+#include <vector>
+#include "parallel.h"
+#include "utils/mutex.h"
+#include "utils/util.h"
+
+using namespace luwu;
+
+static const int s_n = 4000000;
+static std::vector<double> s_data(s_n);
+
+static double work(int i) {
+    return std::sqrt(static_cast<double>(i)) * std::sin(i);
+}
+
+void test_parallel() {
+    Mutex mutex;
+    std::set<uint32_t> threads;
+
+    uint64_t start = getCurrentTime();
+    parallelFor(0, s_n, 100000, [&mutex, &threads](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            s_data[i] = work(i);
+        }
+        Mutex::Lock lock(mutex);
+        threads.insert(getThreadId());
+    });
+    std::cout << "parallelFor " << getCurrentTime() - start << " ms on " << threads.size() << " threads" << std::endl;
+
+    start = getCurrentTime();
+    double sum = parallelReduce(0, s_n, 100000, 0.0, [](int begin, int end) {
+        double sum = 0;
+        for (int i = begin; i < end; ++i) {
+            sum += s_data[i];
+        }
+        return sum;
+    }, [](double a, double b) {
+        return a + b;
+    });
+    std::cout << "parallelReduce " << getCurrentTime() - start << " ms, sum = " << sum << std::endl;
+}
+
+int main() {
+    uint64_t start = getCurrentTime();
+    double expect = 0;
+    for (int i = 0; i < s_n; ++i) {
+        expect += work(i);
+    }
+    std::cout << "serial " << getCurrentTime() - start << " ms, sum = " << expect << std::endl;
+
+    Scheduler scheduler("parallel", 4, false);
+    scheduler.start();
+    scheduler.addTask(test_parallel);
+    scheduler.stop();
+    return 0;
+}
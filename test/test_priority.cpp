@@ -0,0 +1,57 @@
+//
+// Created by liucxi on 2022/12/14.
+//
+
+#include <chrono>
+#include <iostream>
+#include <unistd.h>
+#include "scheduler.h"
+
+using namespace luwu;
+
+static const int s_normal_num = 5000;
+static std::chrono::steady_clock::time_point s_begin;
+static std::atomic<int> s_normal_done{0};
+
+static double elapsed_ms() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - s_begin).count();
+}
+
+// 模拟一个占用 100 微秒 CPU 的普通任务
+void busy_task() {
+    auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(100);
+    while (std::chrono::steady_clock::now() < end);
+    ++s_normal_done;
+}
+
+// 在调度线程内派生大批普通任务，它们都进入本线程的本地队列
+void bulk_producer() {
+    for (int i = 0; i < s_normal_num; ++i) {
+        Scheduler::GetThis()->addTask(busy_task, -1, Fiber::STACK_SMALL);
+    }
+}
+
+int main() {
+    s_begin = std::chrono::steady_clock::now();
+    {
+        Scheduler scheduler("priority", 1, false);
+        scheduler.start();
+        scheduler.addTask(bulk_producer);
+        for (int i = 0; i < 3; ++i) {
+            scheduler.addTask([i]() {
+                std::cout << "background " << i << " at " << elapsed_ms() << " ms, normal done = "
+                          << s_normal_done << std::endl;
+            }, Scheduler::BACKGROUND);
+        }
+
+        usleep(50 * 1000);
+        double submit = elapsed_ms();
+        scheduler.addTask([submit]() {
+            std::cout << "critical waited " << elapsed_ms() - submit << " ms, normal done = "
+                      << s_normal_done << ", expect far less than " << s_normal_num << std::endl;
+        }, Scheduler::CRITICAL);
+        scheduler.stop();
+    }
+    std::cout << "all " << s_normal_done << " normal tasks done at " << elapsed_ms() << " ms" << std::endl;
+    return 0;
+}
@@ -0,0 +1,42 @@
+//
+// Created by liucxi on 2022/12/15.
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include "reactor.h"
+
+using namespace luwu;
+
+static const int s_rounds = 2000;
+
+// 外部线程逐个提交任务，测量从提交到开始执行的平均延迟
+static double measure(uint64_t spin_time, int gap_us) {
+    std::atomic<int64_t> total_ns{0};
+    std::atomic<int> done{0};
+    {
+        Reactor reactor("spin", 2, false);
+        reactor.setSpinTime(spin_time);
+        for (int i = 0; i < s_rounds; ++i) {
+            auto submit = std::chrono::steady_clock::now();
+            reactor.addTask([submit, &total_ns, &done]() {
+                total_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - submit).count();
+                ++done;
+            });
+            std::this_thread::sleep_for(std::chrono::microseconds(gap_us));
+        }
+    }
+    return total_ns / 1000.0 / done;
+}
+
+// 用法：test_reactor_spin [自旋时间(微秒)] [提交间隔(微秒)]
+int main(int argc, char **argv) {
+    uint64_t spin_time = argc > 1 ? static_cast<uint64_t>(atoi(argv[1])) : 50;
+    int gap_us = argc > 2 ? atoi(argv[2]) : 20;
+    std::cout << "no spin: " << measure(0, gap_us) << " us per wakeup" << std::endl;
+    std::cout << "spin " << spin_time << " us: " << measure(spin_time, gap_us) << " us per wakeup" << std::endl;
+    return 0;
+}
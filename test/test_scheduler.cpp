@@ -4,7 +4,11 @@
 
 #include "scheduler.h"
 #include "utils/util.h"
+#include <unistd.h>
+#include <atomic>
 #include <iostream>
+#include <memory>
+#include <vector>
 
 using namespace luwu;
 
@@ -48,21 +52,73 @@ void test_scheduler5() {
     std::cout << getThreadId() << ", " << Fiber::GetFiberId() << " test_scheduler5 end" << std::endl;
 }
 
+static std::atomic<int> s_batch_sum{0};
+
+// 只能移动的函数对象
+struct AddValue {
+    explicit AddValue(int value) : value_(new int(value)) {}
+
+    void operator()() {
+        s_batch_sum += *value_;
+    }
+
+    std::unique_ptr<int> value_;
+};
+
+// 协程不断把自己重新加入调度器再 yield，单线程时它添加的另一个任务也要能得到执行
+static void test_requeue_fairness() {
+    Scheduler scheduler("requeue", 1, false);
+    scheduler.start();
+    std::atomic<int> done{0};
+    std::atomic<bool> finished{false};
+    uint64_t yields = 0;
+    uint64_t begin = getElapseMs();
+    scheduler.addTask([&]() {
+        Scheduler::GetThis()->addTask([&done]() {
+            ++done;
+        });
+        while (done == 0 && getElapseMs() - begin < 2000) {
+            Scheduler::GetThis()->addTask(Fiber::GetThis());
+            Fiber::GetThis()->yield();
+            ++yields;
+        }
+        finished = true;
+    });
+    while (!finished) {
+        usleep(1000);
+    }
+    scheduler.stop();
+    std::cout << "requeue: done = " << done << " after " << yields << " yields, "
+              << getElapseMs() - begin << " ms, expect done = 1" << std::endl;
+}
+
 int main() {
+    test_requeue_fairness();
+
     //std::cout << getThreadId() << ", " << Fiber::GetFiberId() << " main begin" << std::endl;
     // Scheduler scheduler("scheduler");
     // Scheduler scheduler("scheduler", 1, false);
     Scheduler scheduler("scheduler", 1, true);
 
     scheduler.addTask(test_scheduler1);
-    scheduler.addTask(test_scheduler2);
+    scheduler.addTask(test_scheduler2, -1, Fiber::STACK_SMALL);
 
     scheduler.addTask(std::make_shared<Fiber>(test_scheduler3));
+    scheduler.addInlineTask(test_scheduler3);          // 直接在调度协程上执行，协程 id 为调度协程的 id
+    scheduler.addTask(test_scheduler4, getThreadId()); // 调度器所在线程还没有进入调度，先暂存，进入调度时转移到它的信箱
+
+    // 批量添加只能移动的函数任务，任务从 vector 中移走
+    std::vector<Fiber::fiber_func> batch;
+    for (int i = 1; i <= 4; ++i) {
+        batch.emplace_back(AddValue(i));
+    }
+    scheduler.addTasks(batch.begin(), batch.end());
 
     scheduler.start();
 
     scheduler.addTask(test_scheduler5);
     scheduler.stop();
+    std::cout << "batch of move-only tasks sum = " << s_batch_sum << ", expect 10" << std::endl;
 
     //std::cout << getThreadId() << ", " << Fiber::GetFiberId() << " main end" << std::endl;
     return 0;
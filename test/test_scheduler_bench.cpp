@@ -0,0 +1,70 @@
+//
+// Created by liucxi on 2022/12/11.
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "scheduler.h"
+#include "utils/util.h"
+
+using namespace luwu;
+
+static const int s_roots = 64;
+static const int s_children = 2000;
+static std::atomic<uint64_t> s_done{0};
+static bool s_pinned = false;
+
+// 每个根任务在调度线程内派生大量小任务，这些任务进入本线程的本地队列，空闲线程从中窃取；
+// pinned 模式下指定在本线程执行，进入本线程的信箱
+void root_task() {
+    uint32_t tid = s_pinned ? getThreadId() : -1;
+    for (int i = 0; i < s_children; ++i) {
+        Scheduler::GetThis()->addTask([]() {
+            ++s_done;
+        }, tid, Fiber::STACK_SMALL);
+    }
+}
+
+// 用法：test_scheduler_bench [线程数] [local|pinned|external|batch]
+// local 模式下任务由调度线程派生，external 模式下所有任务都由调度器之外的主线程逐个提交，走注入队列，
+// batch 模式下主线程每次用 addTasks 提交一批
+int main(int argc, char **argv) {
+    uint32_t threads = argc > 1 ? static_cast<uint32_t>(atoi(argv[1])) : 4;
+    std::string mode = argc > 2 ? argv[2] : "local";
+    bool external = mode == "external";
+    bool batch = mode == "batch";
+    s_pinned = mode == "pinned";
+
+    auto begin = std::chrono::steady_clock::now();
+    {
+        Scheduler scheduler("bench", threads, false);
+        scheduler.start();
+        for (int i = 0; i < s_roots; ++i) {
+            if (batch) {
+                std::vector<std::function<void()>> tasks(s_children, []() {
+                    ++s_done;
+                });
+                scheduler.addTasks(tasks.begin(), tasks.end(), -1, Fiber::STACK_SMALL);
+                continue;
+            }
+            if (!external) {
+                scheduler.addTask(root_task);
+                continue;
+            }
+            for (int j = 0; j < s_children; ++j) {
+                scheduler.addTask([]() {
+                    ++s_done;
+                }, -1, Fiber::STACK_SMALL);
+            }
+        }
+        scheduler.stop();
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(end - begin).count();
+    std::cout << mode << ", " << threads << " threads, " << s_done << " tasks in " << ms << " ms, "
+              << static_cast<uint64_t>(s_done / ms * 1000) << " tasks/s" << std::endl;
+    return 0;
+}
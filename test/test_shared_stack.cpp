@@ -0,0 +1,118 @@
+//
+// Created by liucxi on 2022/12/4.
+//
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include "logger.h"
+#include "http/ws_server.h"
+
+using namespace luwu;
+
+static const uint16_t s_port = 12346;
+
+static const char s_handshake[] = "GET /luwu HTTP/1.1\r\n"
+                                  "Host: 127.0.0.1\r\n"
+                                  "Connection: Upgrade\r\n"
+                                  "Upgrade: websocket\r\n"
+                                  "Sec-WebSocket-Version: 13\r\n"
+                                  "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n\r\n";
+
+/**
+ * @brief 读取当前进程的常驻内存大小
+ * @return 常驻内存字节数
+ */
+static long residentBytes() {
+    long pages = 0, resident = 0;
+    std::ifstream statm("/proc/self/statm");
+    statm >> pages >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+/**
+ * @brief 在非 hook 的主线程中建立一个 websocket 连接，完成握手后保持空闲
+ * @return 客户端 socket，失败返回 -1
+ */
+static int connectIdleClient() {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(s_port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr.s_addr);
+    if (::connect(fd, (const sockaddr *) &addr, sizeof addr) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    ::send(fd, s_handshake, sizeof(s_handshake) - 1, 0);
+
+    // 读到完整的握手响应，此时服务端的连接协程已经阻塞在 recvMessage 上
+    std::string rsp;
+    char buffer[1024];
+    while (rsp.find("\r\n\r\n") == std::string::npos) {
+        ssize_t n = ::recv(fd, buffer, sizeof buffer, 0);
+        if (n <= 0) {
+            ::close(fd);
+            return -1;
+        }
+        rsp.append(buffer, n);
+    }
+    return fd;
+}
+
+// 用法：test_shared_stack [shared|dedicated] [连接数]
+int main(int argc, char **argv) {
+    bool shared = argc > 1 && strcmp(argv[1], "shared") == 0;
+    int conn_num = argc > 2 ? atoi(argv[2]) : 400;
+    LUWU_LOG_ROOT()->setLoggerLevel(LogLevel::ERROR);
+
+    // 主线程作为客户端，服务端只运行在一个子线程上
+    Reactor r("reactor", 1);
+    r.setSharedStack(shared);
+    r.addTask([&r]() {
+        http::WSServer::ptr server(new http::WSServer("luwu/1.0.0", &r, &r));
+        server->bind(IPv4Address::Create("127.0.0.1", s_port));
+        server->getDispatch()->addExactWSServlet("/luwu", [](http::HttpRequest::ptr req,
+                                                             http::WSFrameMessage::ptr msg,
+                                                             http::WSConnection::ptr conn) -> int {
+            conn->sendMessage(msg);
+            return 0;
+        });
+        server->start();
+    });
+    sleep(1);
+
+    // 先建立并关闭一批连接，让栈缓存、日志等一次性的内存分配先完成
+    std::vector<int> clients;
+    for (int i = 0; i < 16; ++i) {
+        clients.push_back(connectIdleClient());
+    }
+    for (int fd : clients) {
+        ::close(fd);
+    }
+    clients.clear();
+    sleep(1);
+
+    long before = residentBytes();
+    for (int i = 0; i < conn_num; ++i) {
+        int fd = connectIdleClient();
+        if (fd == -1) {
+            std::cout << "connect fail, i = " << i << std::endl;
+            break;
+        }
+        clients.push_back(fd);
+    }
+    sleep(1);
+    long after = residentBytes();
+
+    std::cout << (shared ? "shared stack" : "dedicated stack") << ": " << clients.size()
+              << " idle websocket connections, " << (after - before) / static_cast<long>(clients.size())
+              << " bytes per connection" << std::endl;
+    // 服务器不会主动退出，直接结束进程
+    _exit(0);
+}
@@ -0,0 +1,49 @@
+//
+// Created by liucxi on 2022/12/3.
+//
+
+#include <cstring>
+#include <iostream>
+#include "fiber.h"
+#include "stack_allocator.h"
+
+using namespace luwu;
+
+void test_recycle() {
+    void *stack1 = StackAllocator::Alloc(128 * 1024);
+    memset(stack1, 0, 128 * 1024);
+    StackAllocator::Dealloc(stack1, 128 * 1024);
+
+    // 同一线程再次分配同样大小的栈，应该复用刚刚释放的栈
+    void *stack2 = StackAllocator::Alloc(128 * 1024);
+    std::cout << "stack1 = " << stack1 << ", stack2 = " << stack2
+              << ", recycled = " << (stack1 == stack2) << std::endl;
+    StackAllocator::Dealloc(stack2, 128 * 1024);
+}
+
+void test_fiber_churn() {
+    Fiber::InitMainFiber();
+    for (int i = 0; i < 100000; ++i) {
+        Fiber::ptr fiber(new Fiber([](){}, false));
+        fiber->resume();
+    }
+    std::cout << "fiber churn done" << std::endl;
+}
+
+void overflow(int depth) {
+    char buffer[1024];
+    memset(buffer, depth, sizeof buffer);
+    overflow(depth + 1);
+    std::cout << buffer[0];
+}
+
+// 带任意参数运行时测试栈溢出，预期在保护页上触发 SIGSEGV
+int main(int argc, char **argv) {
+    test_recycle();
+    test_fiber_churn();
+    if (argc > 1) {
+        Fiber::ptr fiber(new Fiber([](){ overflow(0); }, false));
+        fiber->resume();
+    }
+    return 0;
+}
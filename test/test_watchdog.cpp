@@ -0,0 +1,64 @@
+//
+// Created by liucxi on 2022/12/19.
+//
+
+#include <atomic>
+#include <iostream>
+#include <unistd.h>
+#include "fiber.h"
+#include "reactor.h"
+#include "utils/util.h"
+
+using namespace luwu;
+
+static std::atomic<int> s_done{0};
+
+// 计算密集、长时间不让出的处理函数，同一线程上的其他协程都要等它
+void hog() {
+    uint64_t begin = getElapseMs();
+    volatile uint64_t sum = 0;
+    while (getElapseMs() - begin < 200) {
+        sum += 1;
+    }
+    ++s_done;
+}
+
+void short_task() {
+    volatile uint64_t sum = 0;
+    for (int i = 0; i < 1000; ++i) {
+        sum += i;
+    }
+    ++s_done;
+}
+
+int main() {
+    Histogram::Snapshot slices;
+    uint64_t overrun = 0;
+    {
+        Reactor reactor("watchdog", 2, false);
+        // 任务连续运行超过 50 毫秒就报告
+        reactor.setWatchdog(50);
+        for (int i = 0; i < 1000; ++i) {
+            reactor.addTask(short_task);
+        }
+        // 看门狗报告的是时间片开始时的协程名称，一直不让出的任务要在开始之前命名
+        Fiber::ptr hog_fiber(new Fiber(hog));
+        hog_fiber->setName("hog_servlet");
+        reactor.addTask(hog_fiber);
+        while (s_done < 1001) {
+            usleep(1000);
+        }
+        slices = reactor.getSliceHistogram();
+        overrun = reactor.getOverrunNum();
+    }
+    std::cout << "slices = " << slices.count_ << ", expect at least 1001; mean = " << slices.mean()
+              << " us, p50 = " << slices.percentile(0.5) << " us, p99 = " << slices.percentile(0.99)
+              << " us, max = " << slices.max_ / 1000 << " ms, expect about 200" << std::endl;
+    std::cout << "overrun = " << overrun << ", expect 1" << std::endl;
+    for (uint32_t i = 0; i < Histogram::BUCKET_NUM; ++i) {
+        if (slices.buckets_[i]) {
+            std::cout << "  <= " << Histogram::UpperBound(i) << " us: " << slices.buckets_[i] << std::endl;
+        }
+    }
+    return 0;
+}